@@ -6,13 +6,25 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
+#include <cstdlib> // For atoi
 #include <cstring> // For memset and memcpy
-
-// Vertex structure with texture coordinates
-struct Vertex {
-    float x, y, z;
-    float u, v; // Texture coordinates
-};
+#include <chrono>
+
+#include "vertex.h"
+#include "math3d.h"
+#include "mesh.h"
+#include "mesh_opt.h"
+#include "frame_profiler.h"
+#include "gl_mesh.h"
+#include "headless.h"
+#include "instancing.h"
+#include "redraw_scheduler.h"
+#include "shader_program.h"
+#include "asset_pack.h"
+#include "baked_mesh.h"
+#include "texture.h"
+#include "texture_array.h"
+#include "soft_raster.h"
 
 // Vertex Shader Source Code
 const char* vertexShaderSource = R"glsl(
@@ -24,11 +36,16 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// Position dequantization (identity for float vertices)
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
 out vec2 TexCoord;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    vec3 position = aPos * positionScale + positionOffset;
+    gl_Position = projection * view * model * vec4(position, 1.0);
     TexCoord = aTexCoord;
 }
 )glsl";
@@ -40,370 +57,318 @@ out vec4 FragColor;
 
 in vec2 TexCoord;
 
-// We will use texture units 0 to 4
-uniform sampler2D textures[5];
-
-uniform int textureIndex; // To select which texture to use
+// The texture of the face being drawn, bound to unit 0 before each draw
+uniform sampler2D faceTexture;
 
 void main()
 {
-    FragColor = texture(textures[textureIndex], TexCoord);
+    FragColor = texture(faceTexture, TexCoord);
 }
 )glsl";
 
-// Matrix functions
-
-// Set a 4x4 identity matrix
-void setIdentityMatrix(float* mat) {
-    memset(mat, 0, 16 * sizeof(float));
-    mat[0] = mat[5] = mat[10] = mat[15] = 1.0f;
-}
+// Texture array variant (--texture-array): every vertex carries the layer of its
+// face, so the whole pyramid is drawn in one call with one texture bound
+const char* arrayVertexShaderSource = R"glsl(
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+layout (location = 2) in uint aLayer;
 
-// Multiply two 4x4 matrices: result = a * b
-void multiplyMatrices(const float* a, const float* b, float* result) {
-    float temp[16];
-    for(int i = 0; i < 4; i++) { // rows of a
-        for(int j = 0; j < 4; j++) { // columns of b
-            temp[i * 4 + j] = a[i * 4 + 0] * b[0 * 4 + j] +
-                              a[i * 4 + 1] * b[1 * 4 + j] +
-                              a[i * 4 + 2] * b[2 * 4 + j] +
-                              a[i * 4 + 3] * b[3 * 4 + j];
-        }
-    }
-    memcpy(result, temp, 16 * sizeof(float));
-}
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
 
-// Create a perspective projection matrix
-void setPerspectiveMatrix(float* mat, float fov, float aspect, float nearPlane, float farPlane) {
-    float f = 1.0f / tanf(fov * 0.5f * (3.14159265358979323846f / 180.0f));
-    memset(mat, 0, 16 * sizeof(float));
-    mat[0] = f / aspect;
-    mat[5] = f;
-    mat[10] = (farPlane + nearPlane) / (nearPlane - farPlane);
-    mat[11] = -1.0f;
-    mat[14] = (2.0f * farPlane * nearPlane) / (nearPlane - farPlane);
-}
+// Position dequantization (identity for float vertices)
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
 
-// Create a lookAt view matrix
-void setLookAtMatrix(float* mat, float eyeX, float eyeY, float eyeZ,
-                                 float centerX, float centerY, float centerZ,
-                                 float upX, float upY, float upZ) {
-    float forward[3], side[3], up[3];
-    float fwdLen, sideLen, upLen;
-
-    // Compute forward vector (center - eye)
-    forward[0] = centerX - eyeX;
-    forward[1] = centerY - eyeY;
-    forward[2] = centerZ - eyeZ;
-    fwdLen = sqrtf(forward[0]*forward[0] + forward[1]*forward[1] + forward[2]*forward[2]);
-
-    // Normalize forward vector
-    forward[0] /= fwdLen;
-    forward[1] /= fwdLen;
-    forward[2] /= fwdLen;
-
-    // Compute side vector = forward x up
-    side[0] = forward[1]*upZ - forward[2]*upY;
-    side[1] = forward[2]*upX - forward[0]*upZ;
-    side[2] = forward[0]*upY - forward[1]*upX;
-    sideLen = sqrtf(side[0]*side[0] + side[1]*side[1] + side[2]*side[2]);
-
-    // Normalize side vector
-    side[0] /= sideLen;
-    side[1] /= sideLen;
-    side[2] /= sideLen;
-
-    // Recompute up vector = side x forward
-    up[0] = side[1]*forward[2] - side[2]*forward[1];
-    up[1] = side[2]*forward[0] - side[0]*forward[2];
-    up[2] = side[0]*forward[1] - side[1]*forward[0];
-
-    // Set the view matrix
-    mat[0] = side[0];
-    mat[1] = up[0];
-    mat[2] = -forward[0];
-    mat[3] = 0.0f;
-
-    mat[4] = side[1];
-    mat[5] = up[1];
-    mat[6] = -forward[1];
-    mat[7] = 0.0f;
-
-    mat[8] = side[2];
-    mat[9] = up[2];
-    mat[10] = -forward[2];
-    mat[11] = 0.0f;
-
-    mat[12] = - (side[0]*eyeX + side[1]*eyeY + side[2]*eyeZ);
-    mat[13] = - (up[0]*eyeX + up[1]*eyeY + up[2]*eyeZ);
-    mat[14] = forward[0]*eyeX + forward[1]*eyeY + forward[2]*eyeZ;
-    mat[15] = 1.0f;
-}
+out vec2 TexCoord;
+flat out uint Layer;
 
-// Create a rotation matrix around the Y axis
-void setRotationYMatrix(float* mat, float angleDegrees) {
-    float radians = angleDegrees * (3.14159265358979323846f / 180.0f);
-    float cosA = cosf(radians);
-    float sinA = sinf(radians);
-
-    setIdentityMatrix(mat);
-    mat[0] = cosA;
-    mat[2] = sinA;
-    mat[8] = -sinA;
-    mat[10] = cosA;
+void main()
+{
+    vec3 position = aPos * positionScale + positionOffset;
+    gl_Position = projection * view * model * vec4(position, 1.0);
+    TexCoord = aTexCoord;
+    Layer = aLayer;
 }
+)glsl";
 
-// Function to create vertices of a textured pyramid
-void createTexturedPyramid(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, const Vertex& center, float baseSize, float pyramidHeight) {
-    float halfBase = baseSize / 2.0f;
-    float halfHeight = pyramidHeight / 2.0f;
-
-    // Define the 5 unique positions
-    Vertex v0 = { center.x - halfBase, center.y - halfHeight, center.z + halfBase }; // Front-left base
-    Vertex v1 = { center.x + halfBase, center.y - halfHeight, center.z + halfBase }; // Front-right base
-    Vertex v2 = { center.x + halfBase, center.y - halfHeight, center.z - halfBase }; // Back-right base
-    Vertex v3 = { center.x - halfBase, center.y - halfHeight, center.z - halfBase }; // Back-left base
-    Vertex v4 = { center.x, center.y + halfHeight, center.z };                       // Apex
-
-    // Texture coordinates
-    float texCoords[3][2] = {
-        { 0.0f, 0.0f }, // Bottom-left
-        { 1.0f, 0.0f }, // Bottom-right
-        { 0.5f, 1.0f }  // Top-center
-    };
-
-    // Base face (two triangles)
-    // Triangle 1
-    vertices.push_back({ v0.x, v0.y, v0.z, 0.0f, 0.0f }); // v0
-    vertices.push_back({ v1.x, v1.y, v1.z, 1.0f, 0.0f }); // v1
-    vertices.push_back({ v2.x, v2.y, v2.z, 1.0f, 1.0f }); // v2
+const char* arrayFragmentShaderSource = R"glsl(
+#version 330 core
+out vec4 FragColor;
 
-    // Triangle 2
-    vertices.push_back({ v2.x, v2.y, v2.z, 1.0f, 1.0f }); // v2
-    vertices.push_back({ v3.x, v3.y, v3.z, 0.0f, 1.0f }); // v3
-    vertices.push_back({ v0.x, v0.y, v0.z, 0.0f, 0.0f }); // v0
+in vec2 TexCoord;
+flat in uint Layer;
 
-    // Indices for the base
-    for (unsigned int i = 0; i < 6; ++i) {
-        indices.push_back(i);
-    }
+uniform sampler2DArray textureArray;
 
-    // Side faces
-    // Face 1
-    vertices.push_back({ v0.x, v0.y, v0.z, texCoords[0][0], texCoords[0][1] }); // v0
-    vertices.push_back({ v1.x, v1.y, v1.z, texCoords[1][0], texCoords[1][1] }); // v1
-    vertices.push_back({ v4.x, v4.y, v4.z, texCoords[2][0], texCoords[2][1] }); // v4
-
-    // Face 2
-    vertices.push_back({ v1.x, v1.y, v1.z, texCoords[0][0], texCoords[0][1] }); // v1
-    vertices.push_back({ v2.x, v2.y, v2.z, texCoords[1][0], texCoords[1][1] }); // v2
-    vertices.push_back({ v4.x, v4.y, v4.z, texCoords[2][0], texCoords[2][1] }); // v4
-
-    // Face 3
-    vertices.push_back({ v2.x, v2.y, v2.z, texCoords[0][0], texCoords[0][1] }); // v2
-    vertices.push_back({ v3.x, v3.y, v3.z, texCoords[1][0], texCoords[1][1] }); // v3
-    vertices.push_back({ v4.x, v4.y, v4.z, texCoords[2][0], texCoords[2][1] }); // v4
-
-    // Face 4
-    vertices.push_back({ v3.x, v3.y, v3.z, texCoords[0][0], texCoords[0][1] }); // v3
-    vertices.push_back({ v0.x, v0.y, v0.z, texCoords[1][0], texCoords[1][1] }); // v0
-    vertices.push_back({ v4.x, v4.y, v4.z, texCoords[2][0], texCoords[2][1] }); // v4
-
-    // Indices for the sides
-    for (unsigned int i = 6; i < 18; ++i) {
-        indices.push_back(i);
-    }
+void main()
+{
+    FragColor = texture(textureArray, vec3(TexCoord, float(Layer)));
 }
+)glsl";
 
-// Function to load a texture from file
-unsigned int loadTexture(const char* path) {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int texWidth, texHeight, nrChannels;
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char* data = stbi_load(path, &texWidth, &texHeight, &nrChannels, 0);
-    if (data) {
-        GLenum format = GL_RGB;
-        if (nrChannels == 1)
-            format = GL_RED;
-        else if (nrChannels == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, texWidth, texHeight, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        // Set texture wrapping/filtering options
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT); // S axis
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT); // T axis
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); // Minification
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); // Magnification
-
-        stbi_image_free(data);
+int main(int argc, char* argv[]) {
+    // --soft renders with the CPU rasterizer instead of glDrawElements
+    // --packed uploads 12-byte quantized vertices instead of 20-byte floats
+    // --sync-textures decodes the textures serially before the first frame (for comparison)
+    // --no-pack loads loose files and builds the mesh even if lab4.pak exists
+    // --no-shader-cache compiles and links the shaders even if shader_cache/ holds a binary
+    // --texture-array draws all faces in one call from a GL_TEXTURE_2D_ARRAY
+    // --instances N draws N pyramids with one instanced call (implies --texture-array)
+    // --instance-sweep times 1 to 100000 instances and exits
+    // --animate spins the instances, streaming their matrices every frame (1000 unless --instances is given)
+    // --cull views the instances from inside and streams only the ones in view, found with a BVH (1000 unless --instances)
+    // --no-stream-ring streams them with glBufferData instead of the ring buffer (for comparison)
+    // --profile times each render loop stage on the CPU and GPU and writes frame_trace.json on exit
+    // --headless N renders N frames offscreen through EGL (no display needed), reports fps and exits
+    // --continuous redraws as fast as possible instead of only when something changes (for benchmarking)
+    // --output FILE is where --headless saves the last frame (pyramid_headless.png by default)
+    auto launchTime = std::chrono::steady_clock::now();
+    bool useSoftRasterizer = false;
+    bool usePackedVertices = false;
+    bool useAsyncTextures = true;
+    bool useAssetPack = true;
+    bool useShaderCache = true;
+    bool useTextureArray = false;
+    size_t instanceCount = 0;
+    bool instanceSweep = false;
+    bool animate = false;
+    bool cull = false;
+    bool useStreamRing = true;
+    bool useProfiler = false;
+    bool continuous = false;
+    int headlessFrames = 0;
+    const char* outputPath = "pyramid_headless.png";
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--soft") == 0)
+            useSoftRasterizer = true;
+        else if (strcmp(argv[i], "--packed") == 0)
+            usePackedVertices = true;
+        else if (strcmp(argv[i], "--sync-textures") == 0)
+            useAsyncTextures = false;
+        else if (strcmp(argv[i], "--no-pack") == 0)
+            useAssetPack = false;
+        else if (strcmp(argv[i], "--no-shader-cache") == 0)
+            useShaderCache = false;
+        else if (strcmp(argv[i], "--texture-array") == 0)
+            useTextureArray = true;
+        else if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc)
+            instanceCount = (size_t)std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--instance-sweep") == 0)
+            instanceSweep = true;
+        else if (strcmp(argv[i], "--animate") == 0)
+            animate = true;
+        else if (strcmp(argv[i], "--cull") == 0)
+            cull = true;
+        else if (strcmp(argv[i], "--no-stream-ring") == 0)
+            useStreamRing = false;
+        else if (strcmp(argv[i], "--profile") == 0)
+            useProfiler = true;
+        else if (strcmp(argv[i], "--continuous") == 0)
+            continuous = true;
+        else if (strcmp(argv[i], "--headless") == 0 && i + 1 < argc)
+            headlessFrames = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+            outputPath = argv[++i];
     }
-    else {
-        std::cerr << "Failed to load texture: " << path << std::endl;
-        stbi_image_free(data);
+    if ((animate || cull) && instanceCount == 0)
+        instanceCount = 1000;
+    if (instanceSweep)
+        cull = false;   // The sweep draws every instance
+    bool streamInstances = animate || cull;
+    bool useInstancing = instanceCount > 0 || instanceSweep;
+    if (useInstancing)
+        useTextureArray = true;   // Instances keep their per-face layers, offset by the instance's layer
+    auto msSinceLaunch = [&] {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - launchTime).count();
+    };
+    auto secondsSinceLaunch = [&] { return msSinceLaunch() / 1000.0; };   // glfwGetTime needs GLFW; --headless skips it
+
+    // Open a window, or with --headless make an EGL context that renders offscreen
+    GLFWwindow* window = nullptr;
+    HeadlessContext headless;
+    int width = 800, height = 600;
+    if (headlessFrames > 0) {
+        if (!headless.create(width, height))
+            return -1;
     }
+    else {
+        // Initialize GLFW
+        if (!glfwInit()) {
+            std::cerr << "Failed to initialize GLFW" << std::endl;
+            return -1;
+        }
 
-    return textureID;
-}
-
-int main() {
-    // Initialize GLFW
-    if (!glfwInit()) {
-        std::cerr << "Failed to initialize GLFW" << std::endl;
-        return -1;
-    }
+        // Set OpenGL version to 3.3 and use the core profile
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        
+        // Create window
+        window = glfwCreateWindow(width, height, "Textured Pyramid", NULL, NULL);
+        if (!window) {
+            std::cerr << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
 
-    // Set OpenGL version to 3.3 and use the core profile
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    
-    // Create window
-    GLFWwindow* window = glfwCreateWindow(800, 600, "Textured Pyramid", NULL, NULL);
-    if (!window) {
-        std::cerr << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
-    }
+        // Set OpenGL context
+        glfwMakeContextCurrent(window);
 
-    // Set OpenGL context
-    glfwMakeContextCurrent(window);
+        // Initialize GLAD
+        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+            std::cerr << "Failed to initialize GLAD" << std::endl;
+            return -1;
+        }
 
-    // Initialize GLAD
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-        std::cerr << "Failed to initialize GLAD" << std::endl;
-        return -1;
+        // Framebuffer size in pixels
+        glfwGetFramebufferSize(window, &width, &height);
     }
-
-    // Set viewport size
-    int width, height;
-    glfwGetFramebufferSize(window, &width, &height);
     glViewport(0, 0, width, height);
 
-    // Compile and link shaders
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
-
-    // Check for vertex shader compilation errors
-    int success;
-    char infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        std::cerr << "ERROR::VERTEX_SHADER::COMPILATION_FAILED\n" << infoLog << std::endl;
-    }
-
-    // Compile fragment shader
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-
-    // Check for fragment shader compilation errors
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-        std::cerr << "ERROR::FRAGMENT_SHADER::COMPILATION_FAILED\n" << infoLog << std::endl;
-    }
-
-    // Link shaders into program
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-
-    // Check for shader program linking errors
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (!success) {
-        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER_PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
-    }
-
-    // Delete shaders after linking
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-
-    // Get uniform locations
-    int modelLoc = glGetUniformLocation(shaderProgram, "model");
-    int viewLoc  = glGetUniformLocation(shaderProgram, "view");
-    int projLoc  = glGetUniformLocation(shaderProgram, "projection");
-
-    // Create pyramid vertices and indices
+    // Render loop instrumentation; disabled, every scope below is a single branch
+    FrameProfiler profiler;
+    if (useProfiler)
+        profiler.enable();
+
+    // Compile and link shaders (errors are printed), or load the binary cached by an earlier run
+    ShaderProgram shader;
+    const char* vertexSource = useInstancing ? instancedVertexShaderSource
+                             : useTextureArray ? arrayVertexShaderSource
+                                               : vertexShaderSource;
+    const char* fragmentSource = useInstancing ? instancedFragmentShaderSource
+                               : useTextureArray ? arrayFragmentShaderSource
+                                                 : fragmentShaderSource;
+    shader.build(vertexSource, fragmentSource, useShaderCache ? "shader_cache" : nullptr);
+    shader.printBuildReport("Shader startup");
+
+    // Get uniform handles
+    int modelLoc = shader.uniform("model");
+    int viewLoc  = shader.uniform("view");
+    int projLoc  = shader.uniform("projection");
+
+    // Assets come from one mapped archive when lab4.pak (built by pack.cpp) is present
+    AssetPack assets;
+    if (useAssetPack && assets.open("lab4.pak"))
+        assets.printContents("Asset pack lab4.pak");
+
+    // The pyramid mesh, baked into the pack or built here. The baked one has no
+    // layers, so the texture array path always builds it.
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
+    std::vector<uint8_t> layers;    // Texture array layer per vertex
+    BakedMeshView pyramid;
+    AssetView pyramidAsset = useTextureArray ? AssetView() : assets.find(PYRAMID_MESH_ASSET);
+    if (!pyramidAsset || !parseBakedMesh(pyramidAsset.data, pyramidAsset.size, pyramid)) {
+        // Adjust the pyramid size to fit within NDC (-1 to 1)
+        Vertex center = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f }; // Center of the base
+        float baseSize = 1.0f; // Width and depth of the base
+        float pyramidHeight = 1.0f; // Height of the pyramid
+
+        createTexturedPyramid(vertices, indices, center, baseSize, pyramidHeight);
+        if (useTextureArray) {
+            // 6 base vertices, then 3 per side; layers index the array loaded below
+            const uint8_t faceLayers[5] = { 0, 1, 2, 3, 0 };   // brick, trees, soil, water, brick
+            layers.assign(6, faceLayers[0]);
+            for (int i = 1; i < 5; ++i)
+                layers.insert(layers.end(), 3, faceLayers[i]);
+        }
 
-    // Adjust the pyramid size to fit within NDC (-1 to 1)
-    Vertex center = { 0.0f, 0.0f, 0.0f }; // Center of the base
-    float baseSize = 1.0f; // Width and depth of the base
-    float pyramidHeight = 1.0f; // Height of the pyramid
-
-    createTexturedPyramid(vertices, indices, center, baseSize, pyramidHeight);
-
-    // Generate buffers
-    unsigned int VBO, VAO, EBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-
-    // Bind VAO
-    glBindVertexArray(VAO);
-
-    // Bind and fill VBO
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
-
-    // Bind and fill EBO
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
-
-    // Set vertex attributes
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0); // Position
-    glEnableVertexAttribArray(0);
+        // Share vertices between faces where position and texture coordinates (and layer) match
+        MeshReport weldReport = weldVertices(vertices, indices, useTextureArray ? &layers : nullptr);
+        printMeshReport("Pyramid vertex welding", weldReport);
 
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(3 * sizeof(float))); // Texture Coords
-    glEnableVertexAttribArray(1);
+        pyramid.vertices = vertices.data();
+        pyramid.indices = indices.data();
+        pyramid.vertexCount = vertices.size();
+        pyramid.indexCount = indices.size();
+    }
 
-    // Unbind VBO (the VAO keeps the EBO binding)
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    // Unbind VAO
-    glBindVertexArray(0);
+    // Upload to a VAO (16-bit indices, since the vertex count fits)
+    GpuMesh pyramidMesh;
+    if (usePackedVertices) {
+        PackingError packingError;
+        pyramidMesh = uploadPackedMesh(pyramid.vertices, pyramid.vertexCount, pyramid.indices, pyramid.indexCount,
+                                       NO_RESTART_INDEX, &packingError);
+        printPackingError("Pyramid packed vertices", packingError, pyramidMesh.vertexCount);
+    }
+    else {
+        pyramidMesh = uploadMesh(pyramid.vertices, pyramid.vertexCount, pyramid.indices, pyramid.indexCount);
+    }
+    if (useTextureArray)
+        uploadVertexLayers(pyramidMesh, layers);
+    printGpuMesh("Pyramid", pyramidMesh);
+
+    // Load textures for each face through the cache, so brick.jpg (base and
+    // one side) is decoded and uploaded once. Asynchronously, the faces show a
+    // grey placeholder until their image has been decoded and uploaded.
+    AsyncTextureLoader textureLoader;
+    TextureCache textureCache(useAsyncTextures ? &textureLoader : nullptr, &assets);
+    unsigned int textures[5] = {};
+    unsigned int textureArray = 0;
+    shader.use();
+    if (useTextureArray) {
+        // One layer per distinct image, decoded in parallel and resized to a common size
+        size_t arrayBytes;
+        textureArray = loadTextureArray({ "brick.jpg", "trees.jpg", "soil.jpg", "water.jpg" }, 0, 0, TextureOptions(),
+                                        &assets, &arrayBytes);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray);
+        shader.setInt("textureArray", 0);
+        shader.setInt("layerCount", 4);
+        std::cout << "Texture array: 4 layers (" << arrayBytes / 1024.0 << " KiB), loaded "
+                  << msSinceLaunch() << " ms after launch" << std::endl;
+    }
+    else {
+        textures[0] = textureCache.acquire("brick.jpg");
+        textures[1] = textureCache.acquire("trees.jpg");
+        textures[2] = textureCache.acquire("soil.jpg");
+        textures[3] = textureCache.acquire("water.jpg");
+        textures[4] = textureCache.acquire("brick.jpg");
+
+        // Every face samples unit 0; its texture is bound there before it is drawn
+        glActiveTexture(GL_TEXTURE0);
+        shader.setInt("faceTexture", 0);
+    }
 
-    // Load textures for each face
-    unsigned int textures[5];
-    textures[0] = loadTexture("brick.jpg"); 
-    textures[1] = loadTexture("trees.jpg");
-    textures[2] = loadTexture("soil.jpg");
-    textures[3] = loadTexture("water.jpg");
-    textures[4] = loadTexture("brick.jpg");  
+    // Dequantization never changes, so set it once
+    setPositionQuantization(shader, pyramidMesh);
 
-    // Activate texture units and bind textures
-    glUseProgram(shaderProgram);
-    for (int i = 0; i < 5; ++i) {
-        glActiveTexture(GL_TEXTURE0 + i);
-        glBindTexture(GL_TEXTURE_2D, textures[i]);
-        // Set sampler uniforms
-        std::string uniformName = "textures[" + std::to_string(i) + "]";
-        glUniform1i(glGetUniformLocation(shaderProgram, uniformName.c_str()), i);
+    InstanceBuffer instances;
+    if (useInstancing) {
+        uploadInstances(instances, generateInstanceScene(instanceCount, 4));
+        bindInstances(pyramidMesh, instances);
     }
+    InstanceStreamer instanceStreamer;
+    if (streamInstances)
+        instanceStreamer.create(generateInstanceScene(instanceCount, 4), useStreamRing);
+    InstanceCuller instanceCuller;
+    if (cull)
+        instanceCuller.create(generateInstanceScene(instanceCount, 4),
+                              computeBoundingRadius(pyramid.vertices, pyramid.vertexCount));
 
     // Set up the projection matrix
-    float projection[16];
+    Mat4 projection;
     setPerspectiveMatrix(projection, 45.0f, (float)width / height, 0.1f, 100.0f);
 
     // Set up the view matrix
-    float view[16];
+    Mat4 view;
     setLookAtMatrix(view,
                     3.0f, 3.0f, 3.0f,   // Camera position
                     0.0f, 0.0f, 0.0f,   // Target position
                     0.0f, 1.0f, 0.0f);  // Up vector
 
+    // Instanced scenes are framed as a whole
+    if (useInstancing)
+        setInstanceSceneCamera(view, projection, instanceCount, (float)width / height);
+    if (cull)
+        setInstanceSceneInteriorCamera(view, projection, instanceCount, (float)width / height);
+
     // Prepare the model matrix (static rotation)
-    float model[16];
-    float rotation[16];
+    Mat4 model;
+    Mat4 rotation;
     setIdentityMatrix(model);
     setRotationYMatrix(rotation, 45.0f); // Rotate by 45 degrees around Y-axis
     multiplyMatrices(model, rotation, model); // model = model * rotation
@@ -411,51 +376,228 @@ int main() {
     // Enable depth testing
     glEnable(GL_DEPTH_TEST);
 
-    // Main render loop
-    while (!glfwWindowShouldClose(window)) {
+    // Software rasterizer state (mvp = projection * view * model in GL's column-major order)
+    SoftRasterizer softRasterizer;
+    SoftPresenter softPresenter;
+    SoftTexture softTextures[5];
+    Mat4 mvp;
+    if (useSoftRasterizer) {
+        Mat4 modelView;
+        multiplyMatrices(model, view, modelView);
+        multiplyMatrices(modelView, projection, mvp);
+        softRasterizer.setViewport(width, height);
+        const char* texturePaths[5] = { "brick.jpg", "trees.jpg", "soil.jpg", "water.jpg", "brick.jpg" };
+        for (int i = 0; i < 5; ++i)
+            softTextures[i] = loadSoftTexture(texturePaths[i]);
+        std::cout << "Using CPU rasterizer with " << softRasterizer.threadCount() << " threads" << std::endl;
+    }
+
+    if (instanceSweep) {
+        runInstanceSweep("Pyramid", instances, 4, (float)width / height, view, projection, [&] {
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            shader.setMat4(viewLoc, view);
+            shader.setMat4(projLoc, projection);
+            drawMeshInstanced(pyramidMesh, GL_TRIANGLES, instances.count);
+        });
+        if (window)
+            glfwSetWindowShouldClose(window, GLFW_TRUE);
+        headlessFrames = 0;
+    }
+    else if (useInstancing) {
+        std::cout << "Instanced: " << instances.count << " pyramids in one draw call" << std::endl;
+    }
+
+    // Main render loop; unless --continuous (or --animate), a frame is drawn only after something changed
+    RedrawScheduler redraw;
+    redraw.attach(window, continuous || animate);
+    int frameCount = 0;
+    double startTime = secondsSinceLaunch();
+    double submitSeconds = 0.0;                     // CPU time spent issuing GL commands
+    size_t drawCalls = 0;
+    bool texturesReported = useTextureArray;        // The array is complete before the first frame
+    while (window ? !glfwWindowShouldClose(window) : frameCount < headlessFrames) {
+        if (!redraw.waitForFrame())
+            break;
+        redraw.framebufferSize(width, height);
+        ProfileFrame profileFrame(profiler);
+
+        // Upload decoded textures, spending at most 2 ms of each frame on it; until all have arrived,
+        // look for more about once per 60 Hz frame
+        if (textureLoader.pending() > 0) {
+            ProfileScope scope(profiler, "texture upload");
+            textureLoader.uploadPending(2.0);
+            redraw.markDirtyWithin(0.016);
+        }
+        if (!texturesReported && textureLoader.pending() == 0) {
+            std::cout << "All textures uploaded " << msSinceLaunch() << " ms after launch" << std::endl;
+            textureCache.printReport("Texture cache");
+            texturesReported = true;
+        }
+
+        if (useSoftRasterizer) {
+            {
+                ProfileScope scope(profiler, "rasterize", false);
+                softRasterizer.clear(0.1f, 0.1f, 0.1f, 1.0f);
+
+                // Base, then one draw per side with its own texture
+                softRasterizer.drawElements(pyramid.vertices, pyramid.vertexCount, pyramid.indices, 6, mvp,
+                                            &softTextures[0]);
+                for (int i = 0; i < 4; ++i) {
+                    softRasterizer.drawElements(pyramid.vertices, pyramid.vertexCount, pyramid.indices + 6 + i * 3, 3,
+                                                mvp, &softTextures[i + 1]);
+                }
+                softRasterizer.finish();
+            }
+            {
+                ProfileScope scope(profiler, "present");
+                softPresenter.present(softRasterizer.framebuffer(), width, height);
+            }
+            {
+                ProfileScope scope(profiler, "swap", false);
+                if (window) {
+                    glfwSwapBuffers(window);
+                    glfwPollEvents();
+                }
+                else {
+                    headless.endFrame();
+                }
+            }
+            ++frameCount;
+            continue;
+        }
+
+        double submitStart = secondsSinceLaunch();
+
         // Clear the color and depth buffers
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        {
+            ProfileScope scope(profiler, "clear");
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
 
-        // Use shader program
-        glUseProgram(shaderProgram);
+        // Use shader program and pass the matrices to the shader (only uploaded when they change)
+        {
+            ProfileScope scope(profiler, "uniforms");
+            shader.use();
+            shader.setMat4(modelLoc, model);
+            shader.setMat4(viewLoc, view);
+            shader.setMat4(projLoc, projection);
+        }
 
-        // Pass the matrices to the shader
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, model);
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, view);
-        glUniformMatrix4fv(projLoc, 1, GL_FALSE, projection);
+        if (cull) {
+            ProfileScope scope(profiler, "cull", false);
+            instanceCuller.cull(view, projection);
+        }
+        if (streamInstances) {
+            ProfileScope scope(profiler, "stream");
+            instanceStreamer.update(animate ? (float)secondsSinceLaunch() : 0.0f, &pyramidMesh, 1,
+                                    cull ? &instanceCuller.visible() : nullptr);
+        }
 
         // Bind VAO
-        glBindVertexArray(VAO);
+        ProfileScope drawScope(profiler, "draw");
+        glBindVertexArray(pyramidMesh.vao);
 
-        // Draw base
-        glUniform1i(glGetUniformLocation(shaderProgram, "textureIndex"), 0); // Texture unit for base
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-        // Draw sides
-        for (int i = 0; i < 4; ++i) {
-            glUniform1i(glGetUniformLocation(shaderProgram, "textureIndex"), i + 1); // Texture unit for sides
-            glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int) * (6 + i * 3)));
+        if (useInstancing) {
+            // Every pyramid at once; model matrices and layers come from the instance buffer
+            drawMeshInstanced(pyramidMesh, GL_TRIANGLES, cull ? instanceStreamer.count() : instances.count);
+            ++drawCalls;
+        }
+        else if (useTextureArray) {
+            // Every face at once; the layer comes with each vertex
+            drawMeshRange(pyramidMesh, GL_TRIANGLES, 0, pyramidMesh.indexCount);
+            ++drawCalls;
+        }
+        else {
+            // Draw base
+            glBindTexture(GL_TEXTURE_2D, textures[0]);
+            drawMeshRange(pyramidMesh, GL_TRIANGLES, 0, 6);
+            ++drawCalls;
+
+            // Draw sides, rebinding unit 0 for each
+            for (int i = 0; i < 4; ++i) {
+                glBindTexture(GL_TEXTURE_2D, textures[i + 1]);
+                drawMeshRange(pyramidMesh, GL_TRIANGLES, 6 + i * 3, 3);
+                ++drawCalls;
+            }
         }
 
         // Unbind VAO
         glBindVertexArray(0);
+        drawScope.end();
+        if (streamInstances)
+            instanceStreamer.endFrame();
+        submitSeconds += secondsSinceLaunch() - submitStart;
+
+        // Swap buffers and poll events (the GPU timer would only measure the driver's flush)
+        {
+            ProfileScope scope(profiler, "swap", false);
+            if (window) {
+                glfwSwapBuffers(window);
+                glfwPollEvents();
+            }
+            else {
+                headless.endFrame();
+            }
+        }
+        if (frameCount == 0) {
+            std::cout << "Time to first frame: " << msSinceLaunch() << " ms ("
+                      << (useAsyncTextures ? "async" : "serial") << " texture loading)" << std::endl;
+        }
+        ++frameCount;
+    }
 
-        // Swap buffers and poll events
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    redraw.printReport("Redraw");
+
+    // Headless frames are only flushed; wait for the last one before stopping the clock
+    if (!window)
+        glFinish();
+
+    // Report throughput of the selected backend
+    double elapsed = secondsSinceLaunch() - startTime;
+    std::cout << (useSoftRasterizer ? "CPU rasterizer: " : "glDrawElements: ") << frameCount << " frames in "
+              << elapsed << " s (" << (elapsed > 0.0 ? frameCount / elapsed : 0.0) << " fps)" << std::endl;
+    if (!useSoftRasterizer && frameCount > 0) {
+        const char* textureMode = useInstancing ? "Instanced: " : useTextureArray ? "Texture array: " : "Per-face textures: ";
+        std::cout << textureMode << (double)drawCalls / frameCount
+                  << " draw calls per frame, " << 1000.0 * submitSeconds / frameCount << " ms CPU per frame"
+                  << std::endl;
     }
 
-    // Cleanup
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
-    glDeleteProgram(shaderProgram);
+    // Last frame for golden-image comparison (--headless)
+    if (!window && frameCount > 0) {
+        if (headless.writePng(outputPath))
+            std::cout << "Wrote " << outputPath << std::endl;
+        else
+            std::cerr << "Failed to write " << outputPath << std::endl;
+    }
 
+    // Per-stage timings and the trace (--profile)
+    if (profiler.enabled()) {
+        profiler.destroy();
+        profiler.printReport("Frame profile");
+        if (profiler.writeChromeTrace("frame_trace.json"))
+            std::cout << "Wrote frame_trace.json (open in chrome://tracing or ui.perfetto.dev)" << std::endl;
+    }
+
+    // Cleanup
+    deleteMesh(pyramidMesh);
+    deleteInstances(instances);
+    if (streamInstances)
+        instanceStreamer.printReport(animate ? "Animated instances" : "Streamed instances");
+    if (cull)
+        instanceCuller.printReport("Frustum culling");
+    instanceStreamer.destroy();
+    shader.printReport("Shader uniforms");
+    shader.destroy();
+
+    glDeleteTextures(1, &textureArray);
     for (int i = 0; i < 5; ++i) {
-        glDeleteTextures(1, &textures[i]);
+        textureCache.release(textures[i]);
     }
 
+    headless.destroy();
     glfwTerminate();
     return 0;
 }
\ No newline at end of file
@@ -5,14 +5,26 @@
 #include <GLFW/glfw3.h>
 #include <iostream>
 #include <vector>
+#include <chrono>
 #include <cmath>    // For trigonometric functions
+#include <cstdlib>  // For atoi
 #include <cstring>  // For memset and memcpy
 
-// Vertex structure with texture coordinates
-struct Vertex {
-    float x, y, z;   // Position
-    float u, v;      // Texture coordinates
-};
+#include "vertex.h"
+#include "math3d.h"
+#include "mesh.h"
+#include "mesh_opt.h"
+#include "frame_profiler.h"
+#include "gl_mesh.h"
+#include "headless.h"
+#include "instancing.h"
+#include "redraw_scheduler.h"
+#include "shader_program.h"
+#include "asset_pack.h"
+#include "baked_mesh.h"
+#include "texture.h"
+#include "texture_array.h"
+#include "soft_raster.h"
 
 // Shader source codes included as string literals
 
@@ -22,11 +34,15 @@ const char* vertexShaderSource = R"glsl(
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoord;
 
+// Position dequantization (identity for float vertices)
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
 out vec2 TexCoord;
 
 void main()
 {
-    gl_Position = vec4(aPos, 1.0);
+    gl_Position = vec4(aPos * positionScale + positionOffset, 1.0);
     TexCoord = aTexCoord;
 }
 )glsl";
@@ -46,298 +62,525 @@ void main()
 }
 )glsl";
 
-// Function to create vertices of a textured sphere using stack-and-sector method
-void createSphereVertices(
-    std::vector<Vertex>& vertices,
-    std::vector<unsigned int>& indices,
-    float radius,
-    unsigned int sectorCount,
-    unsigned int stackCount)
+int main(int argc, char* argv[])
 {
-    const float PI = 3.14159265359f;
-    float x, y, z, xy;                          // Vertex position
-    float u, v;                                  // Texture coordinates
-    float sectorStep = 2 * PI / sectorCount;
-    float stackStep = PI / stackCount;
-    float sectorAngle, stackAngle;
-
-    for (unsigned int i = 0; i <= stackCount; ++i)
+    // --soft renders with the CPU rasterizer instead of glDrawElements
+    // --triangles draws an indexed triangle list instead of restart-joined strips
+    // --sectors N / --stacks N set the tessellation
+    // --icosphere N builds a subdivided icosahedron (N subdivisions, a triangle list) instead of stacks and sectors
+    // --packed uploads 12-byte quantized vertices instead of 20-byte floats
+    // --split cuts spheres over 65535 vertices into parts with 16-bit indices
+    // --no-pack loads loose files and builds the mesh even if lab4.pak exists
+    // --no-shader-cache compiles and links the shaders even if shader_cache/ holds a binary
+    // --instances N draws N spheres with one instanced call, textured from a texture array
+    // --instance-sweep times 1 to 100000 instances and exits
+    // --animate spins the instances, streaming their matrices every frame (1000 unless --instances is given)
+    // --cull views the instances from inside and streams only the ones in view, found with a BVH (1000 unless --instances)
+    // --lod draws each instance with the coarsest of a chain of tessellations that stays within 1 pixel of error
+    // --lod-error PIXELS sets that screen-space error budget
+    // --no-stream-ring streams them with glBufferData instead of the ring buffer (for comparison)
+    // --profile times each render loop stage on the CPU and GPU and writes frame_trace.json on exit
+    // --headless N renders N frames offscreen through EGL (no display needed), reports fps and exits
+    // --continuous redraws as fast as possible instead of only when something changes (for benchmarking)
+    // --output FILE is where --headless saves the last frame (sphere_headless.png by default)
+    bool useSoftRasterizer = false;
+    bool useStrips = true;
+    bool splitLargeMeshes = false;
+    bool usePackedVertices = false;
+    bool useAssetPack = true;
+    bool useShaderCache = true;
+    size_t instanceCount = 0;
+    bool instanceSweep = false;
+    bool animate = false;
+    bool cull = false;
+    bool useLod = false;
+    float lodPixelError = 1.0f;
+    bool useStreamRing = true;
+    bool useProfiler = false;
+    bool continuous = false;
+    int headlessFrames = 0;
+    const char* outputPath = "sphere_headless.png";
+    unsigned int sectorCount = 36; // Longitude slices
+    unsigned int stackCount = 18;  // Latitude slices
+    int icosphereSubdivisions = -1;
+    for (int i = 1; i < argc; ++i)
     {
-        stackAngle = PI / 2 - i * stackStep;        // From pi/2 to -pi/2
-        xy = radius * cosf(stackAngle);             // r * cos(u)
-        y = radius * sinf(stackAngle);              // r * sin(u)
-
-        for (unsigned int j = 0; j <= sectorCount; ++j)
+        if (strcmp(argv[i], "--soft") == 0)
+            useSoftRasterizer = true;
+        else if (strcmp(argv[i], "--triangles") == 0)
+            useStrips = false;
+        else if (strcmp(argv[i], "--split") == 0)
+            splitLargeMeshes = true;
+        else if (strcmp(argv[i], "--packed") == 0)
+            usePackedVertices = true;
+        else if (strcmp(argv[i], "--no-pack") == 0)
+            useAssetPack = false;
+        else if (strcmp(argv[i], "--no-shader-cache") == 0)
+            useShaderCache = false;
+        else if (strcmp(argv[i], "--sectors") == 0 && i + 1 < argc)
+            sectorCount = (unsigned int)std::max(3, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--stacks") == 0 && i + 1 < argc)
+            stackCount = (unsigned int)std::max(2, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--icosphere") == 0 && i + 1 < argc)
+            icosphereSubdivisions = std::min(std::max(0, atoi(argv[++i])), 8);
+        else if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc)
+            instanceCount = (size_t)std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--instance-sweep") == 0)
+            instanceSweep = true;
+        else if (strcmp(argv[i], "--animate") == 0)
+            animate = true;
+        else if (strcmp(argv[i], "--cull") == 0)
+            cull = true;
+        else if (strcmp(argv[i], "--lod") == 0)
+            useLod = true;
+        else if (strcmp(argv[i], "--lod-error") == 0 && i + 1 < argc)
+            lodPixelError = std::max(0.01f, (float)atof(argv[++i]));
+        else if (strcmp(argv[i], "--no-stream-ring") == 0)
+            useStreamRing = false;
+        else if (strcmp(argv[i], "--profile") == 0)
+            useProfiler = true;
+        else if (strcmp(argv[i], "--continuous") == 0)
+            continuous = true;
+        else if (strcmp(argv[i], "--headless") == 0 && i + 1 < argc)
+            headlessFrames = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+            outputPath = argv[++i];
+    }
+    if ((animate || cull || useLod) && instanceCount == 0)
+        instanceCount = 1000;
+    if (instanceSweep)
+        cull = useLod = false;  // The sweep draws every instance at full detail
+    if (icosphereSubdivisions >= 0)
+        useStrips = useLod = false;     // The LOD chain is made of stack/sector spheres
+    if (useLod)
+        splitLargeMeshes = false;   // Levels share one buffer and are drawn by base vertex
+    bool streamInstances = animate || cull || useLod;
+    bool useInstancing = instanceCount > 0 || instanceSweep;
+
+    // Seconds since startup for animation and timing (glfwGetTime needs GLFW, which --headless does not start)
+    auto launchTime = std::chrono::steady_clock::now();
+    auto secondsSinceLaunch = [&] {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - launchTime).count();
+    };
+
+    // Open a window, or with --headless make an EGL context that renders offscreen
+    GLFWwindow* window = nullptr;
+    HeadlessContext headless;
+    int width = 800, height = 600;
+    if (headlessFrames > 0)
+    {
+        if (!headless.create(width, height))
+            return -1;
+    }
+    else
+    {
+        // Initialize GLFW
+        if (!glfwInit())
         {
-            sectorAngle = j * sectorStep;           // From 0 to 2pi
-
-            // Vertex position
-            x = xy * cosf(sectorAngle);             // x = r * cos(u) * cos(v)
-            z = xy * sinf(sectorAngle);             // z = r * cos(u) * sin(v)
+            std::cerr << "Failed to initialize GLFW" << std::endl;
+            return -1;
+        }
 
-            // Texture coordinates
-            u = (float)j / sectorCount;
-            v = (float)i / stackCount;
+        // Set OpenGL version to 3.3 and use core profile
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-            vertices.push_back({ x, y, z, u, v });
+        // Create window
+        window = glfwCreateWindow(width, height, "Textured Sphere", NULL, NULL);
+        if (!window)
+        {
+            std::cerr << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
         }
-    }
 
-    // Generate indices
-    unsigned int k1, k2;
-    for (unsigned int i = 0; i < stackCount; ++i)
-    {
-        k1 = i * (sectorCount + 1);     // Beginning of current stack
-        k2 = k1 + sectorCount + 1;      // Beginning of next stack
+        // Set OpenGL context
+        glfwMakeContextCurrent(window);
 
-        for (unsigned int j = 0; j < sectorCount; ++j, ++k1, ++k2)
+        // Initialize GLAD
+        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
         {
-            // Two triangles per sector except for the first and last stacks
-            if (i != 0)
-            {
-                // k1, k2, k1+1
-                indices.push_back(k1);
-                indices.push_back(k2);
-                indices.push_back(k1 + 1);
-            }
-
-            if (i != (stackCount - 1))
-            {
-                // k1+1, k2, k2+1
-                indices.push_back(k1 + 1);
-                indices.push_back(k2);
-                indices.push_back(k2 + 1);
-            }
+            std::cerr << "Failed to initialize GLAD" << std::endl;
+            return -1;
         }
-    }
-}
 
-// Function to load a texture from file
-unsigned int loadTexture(const char* path) {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int texWidth, texHeight, nrChannels;
-    stbi_set_flip_vertically_on_load(true); // Flip the image vertically
-    unsigned char* data = stbi_load(path, &texWidth, &texHeight, &nrChannels, 0);
-    if (data) {
-        GLenum format = GL_RGB;
-        if (nrChannels == 1)
-            format = GL_RED;
-        else if (nrChannels == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, texWidth, texHeight, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        // Set texture wrapping/filtering options
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT); // S axis
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT); // T axis
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); // Minification
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); // Magnification
-
-        stbi_image_free(data);
-    }
-    else {
-        std::cerr << "Failed to load texture: " << path << std::endl;
-        stbi_image_free(data);
+        // Framebuffer size in pixels
+        glfwGetFramebufferSize(window, &width, &height);
     }
+    glViewport(0, 0, width, height);
 
-    return textureID;
-}
+    // Render loop instrumentation; disabled, every scope below is a single branch
+    FrameProfiler profiler;
+    if (useProfiler)
+        profiler.enable();
 
-int main()
-{
-    // Initialize GLFW
-    if (!glfwInit())
-    {
-        std::cerr << "Failed to initialize GLFW" << std::endl;
-        return -1;
-    }
+    // Compile and link shaders (errors are printed), or load the binary cached by an earlier run
+    ShaderProgram shader;
+    shader.build(useInstancing ? instancedVertexShaderSource : vertexShaderSource,
+                 useInstancing ? instancedFragmentShaderSource : fragmentShaderSource,
+                 useShaderCache ? "shader_cache" : nullptr);
+    shader.printBuildReport("Shader startup");
 
-    // Set OpenGL version to 3.3 and use core profile
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // Assets come from one mapped archive when lab4.pak (built by pack.cpp) is present
+    AssetPack assets;
+    if (useAssetPack && assets.open("lab4.pak"))
+        assets.printContents("Asset pack lab4.pak");
 
+    // Generate sphere data, unless this tessellation is baked into the pack
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    float radius = 0.5f;
 
-    // Create window
-    GLFWwindow* window = glfwCreateWindow(800, 600, "Textured Sphere", NULL, NULL);
-    if (!window)
+    GLenum primitiveMode = useStrips ? GL_TRIANGLE_STRIP : GL_TRIANGLES;
+    BakedMeshView sphere;
+    std::vector<MeshLod> lodChain;
+    AssetView sphereAsset = useLod || icosphereSubdivisions >= 0
+                                ? AssetView()
+                                : assets.find(sphereMeshAssetName(sectorCount, stackCount, useStrips));
+    if (useLod)
     {
-        std::cerr << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+        // Every level in one vertex and index buffer; sphere is the finest (level 0 comes first)
+        lodChain = createSphereLodChain(vertices, indices, radius, sectorCount, stackCount,
+                                        useStrips ? SphereIndexMode::Strips : SphereIndexMode::Triangles);
+        printLodChain("Sphere LOD chain", lodChain);
+        sphere.vertices = vertices.data();
+        sphere.indices = indices.data();
+        sphere.vertexCount = lodChain[0].vertexCount;
+        sphere.indexCount = lodChain[0].indexCount;
     }
+    else if (!sphereAsset || !parseBakedMesh(sphereAsset.data, sphereAsset.size, sphere))
+    {
+        if (icosphereSubdivisions >= 0)
+            createIcosphereVertices(vertices, indices, radius, (unsigned int)icosphereSubdivisions);
+        else
+            createSphereVerticesFast(vertices, indices, radius, sectorCount, stackCount,
+                                     useStrips ? SphereIndexMode::Strips : SphereIndexMode::Triangles);
 
-    // Set OpenGL context
-    glfwMakeContextCurrent(window);
+        if (!useStrips)
+        {
+            // Reorder triangles for the post-transform cache, then vertices by first use
+            VertexCacheStats cacheBefore = analyzeVertexCache(indices, vertices.size());
+            optimizeVertexCache(indices, vertices.size());
+            optimizeVertexFetch(vertices, indices);
+            printVertexCacheStats("Sphere vertex cache (FIFO 16)", cacheBefore,
+                                  analyzeVertexCache(indices, vertices.size()));
+        }
 
-    // Initialize GLAD
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+        sphere.vertices = vertices.data();
+        sphere.indices = indices.data();
+        sphere.vertexCount = vertices.size();
+        sphere.indexCount = indices.size();
+    }
+    std::cout << "Sphere: " << (useStrips ? "triangle strips, " : "triangle list, ") << sphere.indexCount
+              << " indices (" << sphere.indexCount * sizeof(unsigned int) << " bytes)"
+              << (sphereAsset ? " from the asset pack" : "") << std::endl;
+
+    // Upload: 16-bit indices when the vertex count fits. --split cuts larger
+    // spheres into parts that each fit (as triangle lists; strips are expanded).
+    std::vector<GpuMesh> sphereMeshes;
+    auto upload = [&](const Vertex* meshVertices, size_t vertexCount, const unsigned int* meshIndices,
+                      size_t indexCount, unsigned int restartIndex)
+    {
+        if (!usePackedVertices)
+            return uploadMesh(meshVertices, vertexCount, meshIndices, indexCount, restartIndex);
+        PackingError packingError;
+        GpuMesh mesh = uploadPackedMesh(meshVertices, vertexCount, meshIndices, indexCount, restartIndex,
+                                        &packingError);
+        printPackingError("Sphere packed vertices", packingError, mesh.vertexCount);
+        return mesh;
+    };
+    if (splitLargeMeshes && sphere.vertexCount > MAX_VERTICES_16BIT)
+    {
+        std::vector<unsigned int> sphereIndices(sphere.indices, sphere.indices + sphere.indexCount);
+        std::vector<unsigned int> triangles;
+        if (useStrips)
+            triangleStripToList(sphereIndices, SPHERE_RESTART_INDEX, triangles);
+        else
+            triangles = sphereIndices;
+        std::vector<Vertex> sphereVertices(sphere.vertices, sphere.vertices + sphere.vertexCount);
+        for (const MeshPart& part : splitMesh(sphereVertices, triangles))
+        {
+            sphereMeshes.push_back(upload(part.vertices.data(), part.vertices.size(), part.indices.data(),
+                                          part.indices.size(), NO_RESTART_INDEX));
+        }
+        primitiveMode = GL_TRIANGLES;
+    }
+    else if (useLod)
+    {
+        sphereMeshes.push_back(upload(vertices.data(), vertices.size(), indices.data(), indices.size(),
+                                      useStrips ? SPHERE_RESTART_INDEX : NO_RESTART_INDEX));
+    }
+    else
     {
-        std::cerr << "Failed to initialize GLAD" << std::endl;
-        return -1;
+        sphereMeshes.push_back(upload(sphere.vertices, sphere.vertexCount, sphere.indices, sphere.indexCount,
+                                      useStrips ? SPHERE_RESTART_INDEX : NO_RESTART_INDEX));
     }
+    for (const GpuMesh& mesh : sphereMeshes)
+        printGpuMesh("Sphere", mesh);
+
+    // Load texture (instanced spheres pick one of four layers of a texture array instead)
+    const unsigned int instanceLayers = 4;
+    TextureCache textureCache(nullptr, &assets);
+    unsigned int texture = 0;
+    GLenum textureTarget = GL_TEXTURE_2D;
+    InstanceBuffer instances;
+    if (useInstancing)
+    {
+        texture = loadTextureArray({ "brick.jpg", "trees.jpg", "soil.jpg", "water.jpg" }, 0, 0, TextureOptions(),
+                                   &assets);
+        textureTarget = GL_TEXTURE_2D_ARRAY;
+        uploadInstances(instances, generateInstanceScene(instanceCount, instanceLayers));
+        for (const GpuMesh& mesh : sphereMeshes)
+            bindInstances(mesh, instances);
+    }
+    else
+    {
+        texture = textureCache.acquire("soil.jpg");
+        textureCache.printReport("Texture cache");
+    }
+    InstanceStreamer instanceStreamer;
+    if (streamInstances)
+        instanceStreamer.create(generateInstanceScene(instanceCount, instanceLayers), useStreamRing);
+    InstanceCuller instanceCuller;
+    if (cull)
+        instanceCuller.create(generateInstanceScene(instanceCount, instanceLayers),
+                              computeBoundingRadius(sphere.vertices, sphere.vertexCount));
+    InstanceLodGroups instanceLod;
+    if (useLod)
+        instanceLod.create(generateInstanceScene(instanceCount, instanceLayers), lodChain, lodPixelError);
 
-    // Set viewport size
-    int width, height;
-    glfwGetFramebufferSize(window, &width, &height);
-    glViewport(0, 0, width, height);
+    // Activate texture unit and bind texture
+    shader.use();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(textureTarget, texture);
+    // Set sampler uniform
+    shader.setInt(useInstancing ? "textureArray" : "texture1", 0);
+    shader.setInt("layerCount", (int)instanceLayers);
+
+    // Instanced scenes are framed as a whole (the single sphere is drawn in clip space)
+    int viewLoc = shader.uniform("view");
+    int projLoc = shader.uniform("projection");
+    Mat4 view, projection;
+    setInstanceSceneCamera(view, projection, instanceCount, (float)width / height);
+    if (cull)
+        setInstanceSceneInteriorCamera(view, projection, instanceCount, (float)width / height);
 
-    // Compile and link shaders
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
+    // Enable depth testing
+    glEnable(GL_DEPTH_TEST);
 
-    // Check for vertex shader compilation errors
-    int success;
-    char infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success)
+    // Strips are separated by restart indices (0xFFFF once stored as 16-bit)
+    if (primitiveMode == GL_TRIANGLE_STRIP)
     {
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        std::cerr << "ERROR::VERTEX_SHADER::COMPILATION_FAILED\n"
-                  << infoLog << std::endl;
+        glEnable(GL_PRIMITIVE_RESTART);
+        glPrimitiveRestartIndex(sphereMeshes[0].restartIndex);
     }
 
-    // Compile fragment shader
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-
-    // Check for fragment shader compilation errors
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success)
+    // Software rasterizer state (the vertex shader passes positions through, so mvp is identity)
+    SoftRasterizer softRasterizer;
+    SoftPresenter softPresenter;
+    SoftTexture softTexture;
+    std::vector<unsigned int> softIndices;  // The CPU rasterizer draws triangle lists only
+    Mat4 mvp;
+    setIdentityMatrix(mvp);
+    if (useSoftRasterizer)
     {
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-        std::cerr << "ERROR::FRAGMENT_SHADER::COMPILATION_FAILED\n"
-                  << infoLog << std::endl;
+        std::vector<unsigned int> sphereIndices(sphere.indices, sphere.indices + sphere.indexCount);
+        if (useStrips)
+            triangleStripToList(sphereIndices, SPHERE_RESTART_INDEX, softIndices);
+        else
+            softIndices = sphereIndices;
+        softRasterizer.setViewport(width, height);
+        softTexture = loadSoftTexture("soil.jpg");
+        std::cout << "Using CPU rasterizer with " << softRasterizer.threadCount() << " threads" << std::endl;
     }
 
-    // Link shaders into program
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-
-    // Check for shader program linking errors
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (!success)
+    // Bind VAO and draw the sphere, or every instance of it
+    auto drawSpheres = [&]()
     {
-        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER_PROGRAM::LINKING_FAILED\n"
-                  << infoLog << std::endl;
+        for (const GpuMesh& mesh : sphereMeshes)
+        {
+            setPositionQuantization(shader, mesh);   // Split parts have their own bounds
+            if (useLod)
+            {
+                // One call per level, each reading its group of the streamed instances
+                for (size_t level = 0; level < lodChain.size(); ++level)
+                {
+                    if (instanceLod.levelSize(level) == 0)
+                        continue;
+                    instanceStreamer.bindRange(mesh, instanceLod.levelStart(level));
+                    drawMeshInstancedRange(mesh, primitiveMode, lodChain[level].firstIndex,
+                                           lodChain[level].indexCount, lodChain[level].baseVertex,
+                                           instanceLod.levelSize(level));
+                }
+            }
+            else if (useInstancing)
+                drawMeshInstanced(mesh, primitiveMode, cull ? instanceStreamer.count() : instances.count);
+            else
+                drawMesh(mesh, primitiveMode);
+        }
+        glBindVertexArray(0);
+    };
+    if (instanceSweep)
+    {
+        runInstanceSweep("Sphere", instances, instanceLayers, (float)width / height, view, projection, [&]()
+        {
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            shader.setMat4(viewLoc, view);
+            shader.setMat4(projLoc, projection);
+            drawSpheres();
+        });
+        if (window)
+            glfwSetWindowShouldClose(window, GLFW_TRUE);
+        headlessFrames = 0;
+    }
+    else if (useInstancing)
+    {
+        std::cout << "Instanced: " << instances.count << " spheres in " << sphereMeshes.size()
+                  << " draw call(s)" << std::endl;
     }
 
-    // Delete shaders after linking
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    // Main render loop; unless --continuous (or --animate), a frame is drawn only after something changed
+    RedrawScheduler redraw;
+    redraw.attach(window, continuous || animate);
+    int frameCount = 0;
+    double startTime = secondsSinceLaunch();
+    while (window ? !glfwWindowShouldClose(window) : frameCount < headlessFrames)
+    {
+        if (!redraw.waitForFrame())
+            break;
+        redraw.framebufferSize(width, height);
+        ProfileFrame profileFrame(profiler);
+        if (useSoftRasterizer)
+        {
+            {
+                ProfileScope scope(profiler, "rasterize", false);
+                softRasterizer.clear(0.1f, 0.1f, 0.1f, 1.0f);
+                softRasterizer.drawElements(sphere.vertices, sphere.vertexCount, softIndices.data(), softIndices.size(),
+                                            mvp, &softTexture);
+                softRasterizer.finish();
+            }
+            {
+                ProfileScope scope(profiler, "present");
+                softPresenter.present(softRasterizer.framebuffer(), width, height);
+            }
+        }
+        else
+        {
+            // Clear the color and depth buffers
+            {
+                ProfileScope scope(profiler, "clear");
+                glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            }
 
-    // Generate sphere data
-    std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
-    float radius = 0.5f;
-    unsigned int sectorCount = 36; // Longitude slices
-    unsigned int stackCount = 18;  // Latitude slices
+            // Use shader program (view and projection are only active when instanced)
+            {
+                ProfileScope scope(profiler, "uniforms");
+                shader.use();
+                shader.setMat4(viewLoc, view);
+                shader.setMat4(projLoc, projection);
+            }
 
-    createSphereVertices(vertices, indices, radius, sectorCount, stackCount);
-
-    // Generate buffers
-    unsigned int VBO, VAO, EBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-
-    // Bind VAO
-    glBindVertexArray(VAO);
-
-    // Bind and fill VBO
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER,
-                 vertices.size() * sizeof(Vertex),
-                 &vertices[0],
-                 GL_STATIC_DRAW);
-
-    // Bind and fill EBO
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                 indices.size() * sizeof(unsigned int),
-                 &indices[0],
-                 GL_STATIC_DRAW);
-
-    // Set vertex attributes
-    // Position attribute
-    glVertexAttribPointer(0,
-                          3,
-                          GL_FLOAT,
-                          GL_FALSE,
-                          sizeof(Vertex),
-                          (void*)0);
-    glEnableVertexAttribArray(0);
-
-    // Texture coordinate attribute
-    glVertexAttribPointer(1,
-                          2,
-                          GL_FLOAT,
-                          GL_FALSE,
-                          sizeof(Vertex),
-                          (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    // Unbind VBO (optional)
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    // Unbind VAO (optional)
-    glBindVertexArray(0);
-
-    // Load texture
-    unsigned int texture = loadTexture("soil.jpg");
+            if (cull)
+            {
+                ProfileScope scope(profiler, "cull", false);
+                instanceCuller.cull(view, projection);
+            }
+            if (useLod)
+            {
+                ProfileScope scope(profiler, "lod", false);
+                instanceLod.select(view, projection, height, cull ? &instanceCuller.visible() : nullptr);
+            }
+            if (streamInstances)
+            {
+                ProfileScope scope(profiler, "stream");
+                const std::vector<uint32_t>* subset = useLod ? &instanceLod.order()
+                                                    : cull   ? &instanceCuller.visible()
+                                                             : nullptr;
+                instanceStreamer.update(animate ? (float)secondsSinceLaunch() : 0.0f, sphereMeshes.data(),
+                                        sphereMeshes.size(), subset);
+            }
 
-    // Activate texture unit and bind texture
-    glUseProgram(shaderProgram);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    // Set sampler uniform
-    glUniform1i(glGetUniformLocation(shaderProgram, "texture1"), 0);
+            // Bind texture and draw
+            {
+                ProfileScope scope(profiler, "draw");
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(textureTarget, texture);
+                drawSpheres();
+            }
+            if (streamInstances)
+                instanceStreamer.endFrame();
+        }
 
-    // Enable depth testing
-    glEnable(GL_DEPTH_TEST);
+        // Swap buffers and poll events (the GPU timer would only measure the driver's flush)
+        {
+            ProfileScope scope(profiler, "swap", false);
+            if (window)
+            {
+                glfwSwapBuffers(window);
+                glfwPollEvents();
+            }
+            else
+            {
+                headless.endFrame();
+            }
+        }
+        ++frameCount;
+    }
 
-    // Main render loop
-    while (!glfwWindowShouldClose(window))
+    redraw.printReport("Redraw");
+
+    // Headless frames are only flushed; wait for the last one before stopping the clock
+    if (!window)
+        glFinish();
+
+    // Report throughput of the selected backend
+    double elapsed = secondsSinceLaunch() - startTime;
+    const char* backend = useSoftRasterizer ? "CPU rasterizer: "
+                        : useInstancing     ? "glDrawElementsInstanced: "
+                                            : "glDrawElements: ";
+    std::cout << backend << frameCount << " frames in "
+              << elapsed << " s (" << (elapsed > 0.0 ? frameCount / elapsed : 0.0) << " fps)" << std::endl;
+
+    // Last frame for golden-image comparison (--headless)
+    if (!window && frameCount > 0)
     {
-        // Clear the color and depth buffers
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        // Use shader program
-        glUseProgram(shaderProgram);
-
-        // Bind texture
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture);
-
-        // Bind VAO and draw the sphere
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES,
-                       static_cast<GLsizei>(indices.size()),
-                       GL_UNSIGNED_INT,
-                       0);
-        glBindVertexArray(0);
+        if (headless.writePng(outputPath))
+            std::cout << "Wrote " << outputPath << std::endl;
+        else
+            std::cerr << "Failed to write " << outputPath << std::endl;
+    }
 
-        // Swap buffers and poll events
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    // Per-stage timings and the trace (--profile)
+    if (profiler.enabled())
+    {
+        profiler.destroy();
+        profiler.printReport("Frame profile");
+        if (profiler.writeChromeTrace("frame_trace.json"))
+            std::cout << "Wrote frame_trace.json (open in chrome://tracing or ui.perfetto.dev)" << std::endl;
     }
 
     // Cleanup
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
-    glDeleteProgram(shaderProgram);
-    glDeleteTextures(1, &texture);
-
+    for (GpuMesh& mesh : sphereMeshes)
+        deleteMesh(mesh);
+    deleteInstances(instances);
+    if (streamInstances)
+        instanceStreamer.printReport(animate ? "Animated instances" : "Streamed instances");
+    if (cull)
+        instanceCuller.printReport("Frustum culling");
+    if (useLod)
+        instanceLod.printReport("Sphere LOD");
+    instanceStreamer.destroy();
+    shader.printReport("Shader uniforms");
+    shader.destroy();
+    if (useInstancing)
+        glDeleteTextures(1, &texture);
+    else
+        textureCache.release(texture);
+
+    headless.destroy();
     glfwTerminate();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,190 @@
+#pragma once
+
+// .pak: every asset a demo needs in one file, built by pack.cpp.
+//
+// Layout (little-endian):
+//   AssetPackHeader
+//   AssetPackEntry[entryCount]      sorted by name
+//   name table                      names back to back, not NUL-terminated
+//   blobs, each 16-byte aligned
+// AssetPack maps the whole file once; find() is a binary search over the
+// entries and returns a view into the mapping, so loading an asset copies
+// nothing until the data is handed to GL.
+
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+const char ASSET_PACK_MAGIC[4] = { 'L', 'P', 'A', 'K' };
+const uint32_t ASSET_PACK_VERSION = 1;
+
+enum class AssetType : uint32_t {
+    Raw = 0,
+    Image = 1,          // Encoded image file (JPEG, PNG...), decoded with stb_image
+    Texture = 2,        // Baked .ctex (baked_texture.h)
+    Mesh = 3,           // Baked mesh (baked_mesh.h)
+    Shader = 4,         // GLSL source text
+};
+
+struct AssetPackHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t nameBytes;
+};
+
+struct AssetPackEntry {
+    uint32_t nameOffset;        // Into the name table
+    uint32_t nameLength;
+    AssetType type;
+    uint32_t reserved;
+    uint64_t offset;            // From the start of the file
+    uint64_t size;
+};
+
+// An asset inside a mapped pack; valid while the AssetPack is open
+struct AssetView {
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+    AssetType type = AssetType::Raw;
+
+    explicit operator bool() const { return data != nullptr; }
+    std::string_view text() const { return std::string_view(reinterpret_cast<const char*>(data), size); }
+};
+
+class AssetPack {
+public:
+    // Map path and validate its table of contents; false (and closed) if unusable
+    bool open(const char* path) {
+        close();
+        if (!file.open(path))
+            return false;
+        const unsigned char* data = file.data();
+        size_t size = file.size();
+
+        bool valid = size >= sizeof(AssetPackHeader);
+        if (valid) {
+            header = reinterpret_cast<const AssetPackHeader*>(data);
+            uint64_t tableEnd = sizeof(AssetPackHeader) + (uint64_t)header->entryCount * sizeof(AssetPackEntry);
+            valid = memcmp(header->magic, ASSET_PACK_MAGIC, 4) == 0 && header->version == ASSET_PACK_VERSION &&
+                    tableEnd + header->nameBytes <= size;
+            entries = reinterpret_cast<const AssetPackEntry*>(data + sizeof(AssetPackHeader));
+            names = reinterpret_cast<const char*>(data + tableEnd);
+        }
+        for (uint32_t i = 0; valid && i < header->entryCount; ++i) {
+            const AssetPackEntry& entry = entries[i];
+            valid = (uint64_t)entry.nameOffset + entry.nameLength <= header->nameBytes && entry.offset <= size &&
+                    entry.size <= size - entry.offset && (i == 0 || name(i - 1) < name(i));
+        }
+        if (!valid)
+            close();
+        return valid;
+    }
+
+    void close() {
+        file.close();
+        header = nullptr;
+        entries = nullptr;
+        names = nullptr;
+    }
+
+    bool isOpen() const { return file.isOpen(); }
+    size_t entryCount() const { return header ? header->entryCount : 0; }
+    size_t mappedBytes() const { return file.size(); }
+
+    std::string_view name(size_t i) const {
+        return std::string_view(names + entries[i].nameOffset, entries[i].nameLength);
+    }
+
+    AssetView entry(size_t i) const {
+        return { file.data() + entries[i].offset, (size_t)entries[i].size, entries[i].type };
+    }
+
+    // The asset called name, or an empty view
+    AssetView find(std::string_view assetName) const {
+        size_t first = 0, last = entryCount();
+        while (first < last) {
+            size_t middle = (first + last) / 2;
+            std::string_view candidate = name(middle);
+            if (candidate == assetName)
+                return entry(middle);
+            if (candidate < assetName)
+                first = middle + 1;
+            else
+                last = middle;
+        }
+        return AssetView();
+    }
+
+    void printContents(const char* label) const {
+        printf("%s: %zu assets, %.1f KiB mapped\n", label, entryCount(), mappedBytes() / 1024.0);
+    }
+
+private:
+    MappedFile file;
+    const AssetPackHeader* header = nullptr;
+    const AssetPackEntry* entries = nullptr;
+    const char* names = nullptr;
+};
+
+// One asset for writeAssetPack
+struct AssetPackInput {
+    std::string name;
+    AssetType type = AssetType::Raw;
+    std::vector<unsigned char> data;
+};
+
+// Sort the inputs by name and write them as a .pak; false on I/O error or duplicate names
+inline bool writeAssetPack(const char* path, std::vector<AssetPackInput> inputs) {
+    std::sort(inputs.begin(), inputs.end(),
+              [](const AssetPackInput& a, const AssetPackInput& b) { return a.name < b.name; });
+    for (size_t i = 1; i < inputs.size(); ++i) {
+        if (inputs[i].name == inputs[i - 1].name)
+            return false;
+    }
+
+    AssetPackHeader header;
+    memcpy(header.magic, ASSET_PACK_MAGIC, 4);
+    header.version = ASSET_PACK_VERSION;
+    header.entryCount = (uint32_t)inputs.size();
+
+    std::vector<AssetPackEntry> entries(inputs.size());
+    std::string nameTable;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        entries[i].nameOffset = (uint32_t)nameTable.size();
+        entries[i].nameLength = (uint32_t)inputs[i].name.size();
+        entries[i].type = inputs[i].type;
+        entries[i].reserved = 0;
+        entries[i].size = inputs[i].data.size();
+        nameTable += inputs[i].name;
+    }
+    header.nameBytes = (uint32_t)nameTable.size();
+
+    uint64_t offset = sizeof(header) + entries.size() * sizeof(AssetPackEntry) + nameTable.size();
+    for (AssetPackEntry& entry : entries) {
+        offset = (offset + 15) & ~(uint64_t)15;
+        entry.offset = offset;
+        offset += entry.size;
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (!file)
+        return false;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(entries.data(), sizeof(AssetPackEntry), entries.size(), file) == entries.size() &&
+              fwrite(nameTable.data(), 1, nameTable.size(), file) == nameTable.size();
+    uint64_t position = sizeof(header) + entries.size() * sizeof(AssetPackEntry) + nameTable.size();
+    const char zeros[16] = {};
+    for (size_t i = 0; ok && i < entries.size(); ++i) {
+        ok = fwrite(zeros, 1, (size_t)(entries[i].offset - position), file) == entries[i].offset - position &&
+             fwrite(inputs[i].data.data(), 1, inputs[i].data.size(), file) == inputs[i].data.size();
+        position = entries[i].offset + entries[i].size;
+    }
+    return fclose(file) == 0 && ok;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+// Baked mesh blob: vertices and indices exactly as uploadMesh takes them,
+// stored in an asset pack (asset_pack.h) by pack.cpp so the demos can skip
+// generating, welding and optimizing meshes at startup.
+//
+// Layout (little-endian):
+//   BakedMeshHeader
+//   Vertex[vertexCount]
+//   uint32_t[indexCount]
+
+#include "vertex.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+const char BAKED_MESH_MAGIC[4] = { 'M', 'E', 'S', 'H' };
+
+struct BakedMeshHeader {
+    char magic[4];
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t restartIndex;      // NO_RESTART_INDEX (0) for triangle lists
+};
+
+// Pack names of the meshes the demos generate: "pyramid.mesh", "sphere_36x18_strips.mesh"...
+const char PYRAMID_MESH_ASSET[] = "pyramid.mesh";
+
+inline std::string sphereMeshAssetName(unsigned int sectorCount, unsigned int stackCount, bool strips) {
+    return "sphere_" + std::to_string(sectorCount) + "x" + std::to_string(stackCount) +
+           (strips ? "_strips.mesh" : "_triangles.mesh");
+}
+
+// A baked mesh parsed in place (pointers into the mapped file)
+struct BakedMeshView {
+    const Vertex* vertices = nullptr;
+    const unsigned int* indices = nullptr;
+    size_t vertexCount = 0, indexCount = 0;
+    unsigned int restartIndex = 0;
+};
+
+inline std::vector<unsigned char> bakeMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+                                           unsigned int restartIndex) {
+    BakedMeshHeader header;
+    memcpy(header.magic, BAKED_MESH_MAGIC, 4);
+    header.vertexCount = (uint32_t)vertices.size();
+    header.indexCount = (uint32_t)indices.size();
+    header.restartIndex = restartIndex;
+
+    size_t vertexBytes = vertices.size() * sizeof(Vertex), indexBytes = indices.size() * sizeof(unsigned int);
+    std::vector<unsigned char> blob(sizeof(header) + vertexBytes + indexBytes);
+    memcpy(blob.data(), &header, sizeof(header));
+    memcpy(blob.data() + sizeof(header), vertices.data(), vertexBytes);
+    memcpy(blob.data() + sizeof(header) + vertexBytes, indices.data(), indexBytes);
+    return blob;
+}
+
+// Validate a baked mesh blob (which must be 4-byte aligned) and point view at its arrays
+inline bool parseBakedMesh(const unsigned char* data, size_t size, BakedMeshView& view) {
+    if (size < sizeof(BakedMeshHeader))
+        return false;
+    const BakedMeshHeader* header = reinterpret_cast<const BakedMeshHeader*>(data);
+    if (memcmp(header->magic, BAKED_MESH_MAGIC, 4) != 0)
+        return false;
+    uint64_t expected = sizeof(BakedMeshHeader) + (uint64_t)header->vertexCount * sizeof(Vertex) +
+                        (uint64_t)header->indexCount * sizeof(unsigned int);
+    if (size != expected)
+        return false;
+
+    view.vertices = reinterpret_cast<const Vertex*>(data + sizeof(BakedMeshHeader));
+    view.indices = reinterpret_cast<const unsigned int*>(view.vertices + header->vertexCount);
+    view.vertexCount = header->vertexCount;
+    view.indexCount = header->indexCount;
+    view.restartIndex = header->restartIndex;
+    return true;
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+// .ctex: pre-baked texture container written by texbake.cpp.
+//
+// Layout (little-endian):
+//   BakedTextureHeader
+//   BakedTextureLevel[levelCount]       base level first
+//   level data, each 16-byte aligned    rows tightly packed, bottom row first
+//                                       when BAKED_TEXTURE_FLIPPED is set
+// The pixels are exactly what glTexImage2D wants, so loading is a memory map
+// and one upload per level: no decoding and no glGenerateMipmap.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+const char BAKED_TEXTURE_MAGIC[4] = { 'C', 'T', 'E', 'X' };
+const uint32_t BAKED_TEXTURE_VERSION = 1;
+const uint32_t BAKED_TEXTURE_FLIPPED = 1u << 0;   // Rows stored bottom-up (stbi flip on load)
+
+struct BakedTextureHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t width, height;
+    uint32_t channels;          // 1 to 4, 8 bits each
+    uint32_t levelCount;
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+struct BakedTextureLevel {
+    uint32_t width, height;
+    uint64_t offset;            // From the start of the file
+    uint64_t size;
+};
+
+// A baked texture parsed in place (pointers into the mapped file)
+struct BakedTextureView {
+    const BakedTextureHeader* header = nullptr;
+    const BakedTextureLevel* levels = nullptr;
+    const unsigned char* base = nullptr;
+
+    const unsigned char* levelData(uint32_t level) const { return base + levels[level].offset; }
+};
+
+// "textures/brick.jpg" -> "textures/brick.ctex"
+inline std::string bakedTexturePath(const std::string& sourcePath) {
+    size_t slash = sourcePath.find_last_of("/\\");
+    size_t dot = sourcePath.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return sourcePath + ".ctex";
+    return sourcePath.substr(0, dot) + ".ctex";
+}
+
+// Validate a .ctex image and point view at its parts; false if anything is out of range
+inline bool parseBakedTexture(const unsigned char* data, size_t size, BakedTextureView& view) {
+    if (size < sizeof(BakedTextureHeader))
+        return false;
+    const BakedTextureHeader* header = reinterpret_cast<const BakedTextureHeader*>(data);
+    if (memcmp(header->magic, BAKED_TEXTURE_MAGIC, 4) != 0 || header->version != BAKED_TEXTURE_VERSION)
+        return false;
+    if (header->channels < 1 || header->channels > 4 || header->levelCount == 0 || header->levelCount > 32)
+        return false;
+    if (size < sizeof(BakedTextureHeader) + header->levelCount * sizeof(BakedTextureLevel))
+        return false;
+
+    const BakedTextureLevel* levels = reinterpret_cast<const BakedTextureLevel*>(data + sizeof(BakedTextureHeader));
+    for (uint32_t i = 0; i < header->levelCount; ++i) {
+        uint64_t expected = (uint64_t)levels[i].width * levels[i].height * header->channels;
+        if (levels[i].size != expected || levels[i].offset > size || levels[i].size > size - levels[i].offset)
+            return false;
+    }
+
+    view.header = header;
+    view.levels = levels;
+    view.base = data;
+    return true;
+}
+
+// Next mip level: 2x2 box filter, odd edges reuse the last row/column
+inline std::vector<unsigned char> downsampleLevel(const unsigned char* src, int width, int height, int channels,
+                                                  int& outWidth, int& outHeight) {
+    outWidth = std::max(1, width / 2);
+    outHeight = std::max(1, height / 2);
+    std::vector<unsigned char> dst((size_t)outWidth * outHeight * channels);
+    for (int y = 0; y < outHeight; ++y) {
+        int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+        for (int x = 0; x < outWidth; ++x) {
+            int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+            for (int c = 0; c < channels; ++c) {
+                int sum = src[((size_t)y0 * width + x0) * channels + c] + src[((size_t)y0 * width + x1) * channels + c] +
+                          src[((size_t)y1 * width + x0) * channels + c] + src[((size_t)y1 * width + x1) * channels + c];
+                dst[((size_t)y * outWidth + x) * channels + c] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+    return dst;
+}
+
+// Build the full mip chain of pixels and write it as a .ctex file
+inline bool writeBakedTexture(const char* path, const unsigned char* pixels, int width, int height, int channels,
+                              uint32_t flags) {
+    std::vector<std::vector<unsigned char>> chain;
+    std::vector<BakedTextureLevel> levels;
+    chain.emplace_back(pixels, pixels + (size_t)width * height * channels);
+    levels.push_back({ (uint32_t)width, (uint32_t)height, 0, chain.back().size() });
+    while (levels.back().width > 1 || levels.back().height > 1) {
+        int w, h;
+        chain.push_back(downsampleLevel(chain.back().data(), (int)levels.back().width, (int)levels.back().height,
+                                        channels, w, h));
+        levels.push_back({ (uint32_t)w, (uint32_t)h, 0, chain.back().size() });
+    }
+
+    BakedTextureHeader header;
+    memcpy(header.magic, BAKED_TEXTURE_MAGIC, 4);
+    header.version = BAKED_TEXTURE_VERSION;
+    header.width = (uint32_t)width;
+    header.height = (uint32_t)height;
+    header.channels = (uint32_t)channels;
+    header.levelCount = (uint32_t)levels.size();
+    header.flags = flags;
+    header.reserved = 0;
+
+    uint64_t offset = sizeof(header) + levels.size() * sizeof(BakedTextureLevel);
+    for (BakedTextureLevel& level : levels) {
+        offset = (offset + 15) & ~(uint64_t)15;
+        level.offset = offset;
+        offset += level.size;
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (!file)
+        return false;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(levels.data(), sizeof(BakedTextureLevel), levels.size(), file) == levels.size();
+    uint64_t position = sizeof(header) + levels.size() * sizeof(BakedTextureLevel);
+    const char zeros[16] = {};
+    for (size_t i = 0; ok && i < levels.size(); ++i) {
+        ok = fwrite(zeros, 1, (size_t)(levels[i].offset - position), file) == levels[i].offset - position &&
+             fwrite(chain[i].data(), 1, chain[i].size(), file) == chain[i].size();
+        position = levels[i].offset + levels[i].size;
+    }
+    return fclose(file) == 0 && ok;
+}
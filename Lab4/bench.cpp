@@ -0,0 +1,787 @@
+// Microbenchmarks for the Lab4 helpers (no GL context needed).
+//
+// Build: g++ -O2 -std=c++17 [-mavx] bench.cpp -o bench -lpthread
+// Usage: ./bench            run every benchmark
+//        ./bench math ...   run the named benchmarks only
+
+#include "culling.h"
+#include "lod.h"
+#include "math3d.h"
+#include "mesh.h"
+#include "mesh_opt.h"
+#include "packed_vertex.h"
+#include "scene_graph.h"
+#include "static_mesh.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+// Keeps the optimizer from discarding benchmark results
+static volatile float benchSink;
+
+// Run fn repeatedly for at least minSeconds and return nanoseconds per call
+static double timeNs(const std::function<void()>& fn, double minSeconds = 0.25) {
+    using Clock = std::chrono::steady_clock;
+    fn(); // Warm up caches
+    size_t calls = 0;
+    Clock::time_point start = Clock::now();
+    double elapsed = 0.0;
+    do {
+        fn();
+        ++calls;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (elapsed < minSeconds);
+    return elapsed * 1e9 / calls;
+}
+
+// The scalar helpers the demos used before math3d.h, kept as the baseline
+namespace scalar {
+
+void multiplyMatrices(const float* a, const float* b, float* result) {
+    float temp[16];
+    for(int i = 0; i < 4; i++) { // rows of a
+        for(int j = 0; j < 4; j++) { // columns of b
+            temp[i * 4 + j] = a[i * 4 + 0] * b[0 * 4 + j] +
+                              a[i * 4 + 1] * b[1 * 4 + j] +
+                              a[i * 4 + 2] * b[2 * 4 + j] +
+                              a[i * 4 + 3] * b[3 * 4 + j];
+        }
+    }
+    memcpy(result, temp, 16 * sizeof(float));
+}
+
+void transformPoint(const float* m, const float* p, float* out) {
+    for (int r = 0; r < 4; r++)
+        out[r] = m[r] * p[0] + m[4 + r] * p[1] + m[8 + r] * p[2] + m[12 + r] * p[3];
+}
+
+} // namespace scalar
+
+static void fillMatrix(Mat4& m, unsigned seed) {
+    for (int i = 0; i < 16; ++i)
+        m.m[i] = (float)((seed * 31u + i * 17u) % 97u) / 97.0f - 0.5f;
+}
+
+static void benchMath() {
+    const size_t count = 4096;
+    std::vector<Mat4> a(count), b(count), simdOut(count), scalarOut(count);
+    std::vector<Vec4> points(count * 64), simdPoints(count * 64), scalarPoints(count * 64);
+    for (size_t i = 0; i < count; ++i) {
+        fillMatrix(a[i], (unsigned)i);
+        fillMatrix(b[i], (unsigned)i + 7u);
+    }
+    for (size_t i = 0; i < points.size(); ++i)
+        points[i] = { (float)(i % 13), (float)(i % 7), (float)(i % 5), 1.0f };
+
+    // Check both paths agree before timing them
+    float maxError = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        scalar::multiplyMatrices(a[i].m, b[i].m, scalarOut[i].m);
+        multiplyMatrices(a[i], b[i], simdOut[i]);
+        for (int k = 0; k < 16; ++k)
+            maxError = std::max(maxError, std::fabs(scalarOut[i].m[k] - simdOut[i].m[k]));
+    }
+    transformPoints(a[0], points.data(), simdPoints.data(), points.size());
+    for (size_t i = 0; i < points.size(); ++i) {
+        scalar::transformPoint(a[0].m, &points[i].x, &scalarPoints[i].x);
+        maxError = std::max(maxError, std::fabs(scalarPoints[i].x - simdPoints[i].x));
+        maxError = std::max(maxError, std::fabs(scalarPoints[i].w - simdPoints[i].w));
+    }
+#if defined(MATH3D_AVX)
+    printf("math (AVX kernels), max |simd - scalar| = %g\n", maxError);
+#elif defined(MATH3D_SSE)
+    printf("math (SSE kernels), max |simd - scalar| = %g\n", maxError);
+#else
+    printf("math (scalar fallback), max |simd - scalar| = %g\n", maxError);
+#endif
+
+    double scalarMul = timeNs([&] {
+        for (size_t i = 0; i < count; ++i)
+            scalar::multiplyMatrices(a[i].m, b[i].m, scalarOut[i].m);
+        benchSink = scalarOut[count - 1].m[5];
+    }) / count;
+    double simdMul = timeNs([&] {
+        for (size_t i = 0; i < count; ++i)
+            multiplyMatrices(a[i], b[i], simdOut[i]);
+        benchSink = simdOut[count - 1].m[5];
+    }) / count;
+    double batchMul = timeNs([&] {
+        multiplyMatrices(a.data(), b.data(), simdOut.data(), count);
+        benchSink = simdOut[count - 1].m[5];
+    }) / count;
+    double sharedMul = timeNs([&] {
+        multiplyMatrices(a.data(), b[0], simdOut.data(), count);
+        benchSink = simdOut[count - 1].m[5];
+    }) / count;
+
+    double scalarXform = timeNs([&] {
+        for (size_t i = 0; i < points.size(); ++i)
+            scalar::transformPoint(a[0].m, &points[i].x, &scalarPoints[i].x);
+        benchSink = scalarPoints.back().y;
+    }) / points.size();
+    double simdXform = timeNs([&] {
+        transformPoints(a[0], points.data(), simdPoints.data(), points.size());
+        benchSink = simdPoints.back().y;
+    }) / points.size();
+
+    printf("  %-34s %8.2f ns\n", "mat4 multiply (scalar)", scalarMul);
+    printf("  %-34s %8.2f ns  (%.2fx)\n", "mat4 multiply (simd)", simdMul, scalarMul / simdMul);
+    printf("  %-34s %8.2f ns  (%.2fx)\n", "mat4 multiply batch a[i]*b[i]", batchMul, scalarMul / batchMul);
+    printf("  %-34s %8.2f ns  (%.2fx)\n", "mat4 multiply batch a[i]*b", sharedMul, scalarMul / sharedMul);
+    printf("  %-34s %8.2f ns\n", "transform point (scalar)", scalarXform);
+    printf("  %-34s %8.2f ns  (%.2fx)\n", "transform point batch (simd)", simdXform, scalarXform / simdXform);
+}
+
+static void benchSphere() {
+    struct Size { unsigned int sectors, stacks; };
+    const Size sizes[] = { { 36, 18 }, { 256, 128 }, { 1024, 512 }, { 2048, 1024 }, { 1024, 2048 } };
+
+    printf("sphere generation (%u threads)\n", defaultThreadPool().size());
+    printf("  %-16s %10s %12s %12s %8s\n", "sectors x stacks", "vertices", "reference", "fast", "speedup");
+    for (const Size& size : sizes) {
+        std::vector<Vertex> refVertices, fastVertices;
+        std::vector<unsigned int> refIndices, fastIndices;
+        createSphereVertices(refVertices, refIndices, 0.5f, size.sectors, size.stacks);
+        createSphereVerticesFast(fastVertices, fastIndices, 0.5f, size.sectors, size.stacks);
+        bool identical = refVertices.size() == fastVertices.size() && refIndices == fastIndices &&
+                         memcmp(refVertices.data(), fastVertices.data(), refVertices.size() * sizeof(Vertex)) == 0;
+        if (!identical) {
+            printf("  %ux%u: fast generator output differs from createSphereVertices\n", size.sectors, size.stacks);
+            continue;
+        }
+
+        // Fresh vectors every call so the reference pays for its reallocations
+        double refMs = timeNs([&] {
+            std::vector<Vertex> v;
+            std::vector<unsigned int> i;
+            createSphereVertices(v, i, 0.5f, size.sectors, size.stacks);
+            benchSink = v.back().x;
+        }, 0.5) / 1e6;
+        double fastMs = timeNs([&] {
+            std::vector<Vertex> v;
+            std::vector<unsigned int> i;
+            createSphereVerticesFast(v, i, 0.5f, size.sectors, size.stacks);
+            benchSink = v.back().x;
+        }, 0.5) / 1e6;
+
+        char label[32];
+        snprintf(label, sizeof(label), "%ux%u", size.sectors, size.stacks);
+        printf("  %-16s %10zu %9.3f ms %9.3f ms %7.2fx\n", label, refVertices.size(), refMs, fastMs, refMs / fastMs);
+    }
+
+    // Strip output: every list triangle must come back out of the strips (plus
+    // the zero-area pole triangles the list skips), with the same winding
+    printf("  %-16s %12s %12s %8s\n", "strip indices", "list bytes", "strip bytes", "ratio");
+    for (const Size& size : sizes) {
+        std::vector<Vertex> vertices, stripVertices;
+        std::vector<unsigned int> listIndices, stripIndices, unstripped;
+        createSphereVerticesFast(vertices, listIndices, 0.5f, size.sectors, size.stacks);
+        createSphereVerticesFast(stripVertices, stripIndices, 0.5f, size.sectors, size.stacks, SphereIndexMode::Strips);
+        triangleStripToList(stripIndices, SPHERE_RESTART_INDEX, unstripped);
+
+        auto canonical = [](const std::vector<unsigned int>& indices) {
+            std::vector<std::array<unsigned int, 3>> triangles;
+            for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+                std::array<unsigned int, 3> t = { indices[i], indices[i + 1], indices[i + 2] };
+                std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+                triangles.push_back(t);
+            }
+            std::sort(triangles.begin(), triangles.end());
+            return triangles;
+        };
+        auto listTriangles = canonical(listIndices), stripTriangles = canonical(unstripped);
+        bool covered = std::includes(stripTriangles.begin(), stripTriangles.end(), listTriangles.begin(), listTriangles.end()) &&
+                       stripTriangles.size() == listTriangles.size() + 2 * size.sectors &&
+                       stripIndices.size() == sphereStripIndexCount(size.sectors, size.stacks);
+
+        char label[32];
+        snprintf(label, sizeof(label), "%ux%u", size.sectors, size.stacks);
+        size_t listBytes = listIndices.size() * sizeof(unsigned int);
+        size_t stripBytes = stripIndices.size() * sizeof(unsigned int);
+        printf("  %-16s %12zu %12zu %7.2fx%s\n", label, listBytes, stripBytes, (double)listBytes / stripBytes,
+               covered ? "" : "  MISMATCH");
+    }
+}
+
+// Compare a compile-time mesh against its runtime generator
+template <size_t V, size_t I>
+static void compareMesh(const char* name, const std::array<Vertex, V>& staticVertices,
+                        const std::array<unsigned int, I>& staticIndices,
+                        const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices) {
+    if (vertices.size() != V || indices.size() != I) {
+        printf("  %-14s size mismatch: %zu/%zu vertices, %zu/%zu indices\n",
+               name, V, vertices.size(), I, indices.size());
+        return;
+    }
+    // Distance in units in the last place: adjacent floats of the same sign differ by 1 in their bits
+    auto ulps = [](float a, float b) {
+        int32_t ia, ib;
+        memcpy(&ia, &a, sizeof(float));
+        memcpy(&ib, &b, sizeof(float));
+        if ((ia < 0) != (ib < 0))
+            return a == b ? (int64_t)0 : (int64_t)(ia & 0x7FFFFFFF) + (ib & 0x7FFFFFFF);
+        return std::abs((int64_t)ia - ib);
+    };
+    size_t exact = 0;
+    float maxError = 0.0f;
+    int64_t maxUlps = 0;
+    for (size_t i = 0; i < V; ++i) {
+        if (memcmp(&staticVertices[i], &vertices[i], sizeof(Vertex)) == 0)
+            ++exact;
+        const float* a = &staticVertices[i].x;
+        const float* b = &vertices[i].x;
+        for (int k = 0; k < 5; ++k) {
+            maxError = std::max(maxError, std::fabs(a[k] - b[k]));
+            maxUlps = std::max(maxUlps, ulps(a[k], b[k]));
+        }
+    }
+    bool sameIndices = std::equal(staticIndices.begin(), staticIndices.end(), indices.begin());
+    printf("  %-17s %5zu/%-5zu vertices bit-identical, all within %lld ulp (max |diff| = %g), indices %s\n",
+           name, exact, V, (long long)maxUlps, maxError, sameIndices ? "identical" : "DIFFER");
+}
+
+static void benchStaticMesh() {
+    printf("compile-time meshes vs runtime generators\n");
+
+    std::vector<Vertex> vertices(24);
+    std::vector<unsigned int> indices(36);
+    Vertex center = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    createBoxVertices(vertices.data(), center, 1.0f, 1.0f, 1.0f);
+    createBoxIndices(indices.data());
+    compareMesh("Box<>", Box<>::vertices, Box<>::indices, vertices, indices);
+
+    vertices.clear();
+    indices.clear();
+    createTexturedPyramid(vertices, indices, center, 1.0f, 1.0f);
+    compareMesh("Pyramid<>", Pyramid<>::vertices, Pyramid<>::indices, vertices, indices);
+
+    vertices.clear();
+    indices.clear();
+    createSphereVertices(vertices, indices, 0.5f, 36, 18);
+    compareMesh("Sphere<36,18>", Sphere<36, 18>::vertices, Sphere<36, 18>::indices, vertices, indices);
+
+    vertices.clear();
+    indices.clear();
+    createSphereVertices(vertices, indices, 1.0f, 64, 32);
+    compareMesh("Sphere<64,32,1,1>", Sphere<64, 32, 1, 1>::vertices, Sphere<64, 32, 1, 1>::indices, vertices, indices);
+}
+
+static void benchWeld() {
+    printf("vertex welding\n");
+
+    Vertex center = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    std::vector<Vertex> vertices(Box<>::vertices.begin(), Box<>::vertices.end());
+    std::vector<unsigned int> indices(Box<>::indices.begin(), Box<>::indices.end());
+    printMeshReport("  box", weldVertices(vertices, indices));
+
+    vertices.clear();
+    indices.clear();
+    createTexturedPyramid(vertices, indices, center, 1.0f, 1.0f);
+    printMeshReport("  pyramid", weldVertices(vertices, indices));
+
+    vertices.clear();
+    indices.clear();
+    createSphereVertices(vertices, indices, 0.5f, 36, 18);
+    printMeshReport("  sphere 36x18", weldVertices(vertices, indices));
+
+    // An unindexed triangle soup, as imported meshes often are, welds back to the shared form
+    std::vector<Vertex> sphereVertices;
+    std::vector<unsigned int> sphereIndices;
+    createSphereVerticesFast(sphereVertices, sphereIndices, 0.5f, 512, 256);
+    std::vector<Vertex> soup;
+    std::vector<unsigned int> soupIndices;
+    soup.reserve(sphereIndices.size());
+    for (unsigned int index : sphereIndices) {
+        soupIndices.push_back((unsigned int)soup.size());
+        soup.push_back(sphereVertices[index]);
+    }
+    vertices = soup;
+    indices = soupIndices;
+    printMeshReport("  sphere 512x256 soup", weldVertices(vertices, indices));
+
+    double ms = timeNs([&] {
+        vertices = soup;
+        indices = soupIndices;
+        weldVertices(vertices, indices);
+        benchSink = vertices.back().x;
+    }, 0.5) / 1e6;
+    printf("  weld %zu-vertex soup: %.2f ms (%.1f ns/vertex, includes copying the input)\n",
+           soup.size(), ms, ms * 1e6 / soup.size());
+}
+
+// Sorted list of triangles, each rotated so its smallest index comes first (winding kept)
+static std::vector<std::array<unsigned int, 3>> canonicalTriangles(const std::vector<Vertex>& vertices,
+                                                                 const std::vector<unsigned int>& indices) {
+    // Compare by vertex content so a vertex-fetch remap still matches
+    std::vector<std::array<unsigned int, 3>> triangles;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        std::array<unsigned int, 3> t;
+        for (int k = 0; k < 3; ++k)
+            t[k] = hashVertex(vertices[indices[i + k]]);
+        std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+        triangles.push_back(t);
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+static void reportVertexCache(const char* label, std::vector<Vertex> vertices, std::vector<unsigned int> indices) {
+    auto trianglesBefore = canonicalTriangles(vertices, indices);
+    VertexCacheStats fifo16 = analyzeVertexCache(indices, vertices.size(), 16);
+    VertexCacheStats fifo32 = analyzeVertexCache(indices, vertices.size(), 32);
+
+    double ms = timeNs([&] {
+        std::vector<unsigned int> copy = indices;
+        optimizeVertexCache(copy, vertices.size());
+        benchSink = (float)copy[0];
+    }, 0.25) / 1e6;
+    optimizeVertexCache(indices, vertices.size());
+    optimizeVertexFetch(vertices, indices);
+
+    printf("  %s (%zu triangles, optimize %.2f ms)\n", label, indices.size() / 3, ms);
+    printVertexCacheStats("    FIFO 16", fifo16, analyzeVertexCache(indices, vertices.size(), 16));
+    printVertexCacheStats("    FIFO 32", fifo32, analyzeVertexCache(indices, vertices.size(), 32));
+    printf("    same triangles: %s\n", canonicalTriangles(vertices, indices) == trianglesBefore ? "yes" : "NO");
+}
+
+static void benchVertexCache() {
+    printf("vertex cache optimization\n");
+
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    createSphereVertices(vertices, indices, 0.5f, 36, 18);
+    reportVertexCache("sphere 36x18", vertices, indices);
+
+    vertices.clear();
+    indices.clear();
+    createSphereVerticesFast(vertices, indices, 0.5f, 256, 128);
+    reportVertexCache("sphere 256x128", vertices, indices);
+
+    // Imported meshes often arrive with triangles in arbitrary order
+    std::vector<unsigned int> shuffled(indices.size());
+    size_t triangleCount = indices.size() / 3;
+    for (size_t t = 0; t < triangleCount; ++t) {
+        size_t from = (t * 7919) % triangleCount;       // 7919 is prime and does not divide the count
+        memcpy(&shuffled[t * 3], &indices[from * 3], 3 * sizeof(unsigned int));
+    }
+    reportVertexCache("sphere 256x128, shuffled triangles", vertices, shuffled);
+}
+
+static void benchSplit() {
+    printf("16-bit mesh splitting\n");
+
+    struct Size { unsigned int sectors, stacks; };
+    const Size sizes[] = { { 256, 128 }, { 512, 256 }, { 1024, 512 } };
+    for (const Size& size : sizes) {
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        createSphereVerticesFast(vertices, indices, 0.5f, size.sectors, size.stacks);
+
+        std::vector<MeshPart> parts;
+        double ms = timeNs([&] {
+            parts = splitMesh(vertices, indices);
+            benchSink = (float)parts.size();
+        }, 0.25) / 1e6;
+
+        // Every part must fit 16-bit indices and together they must hold the same triangles
+        std::vector<Vertex> joinedVertices;
+        std::vector<unsigned int> joinedIndices;
+        size_t partVertices = 0;
+        bool fits = true;
+        for (const MeshPart& part : parts) {
+            fits = fits && part.vertices.size() <= 0xFFFF;
+            for (unsigned int index : part.indices)
+                joinedIndices.push_back(index + (unsigned int)joinedVertices.size());
+            joinedVertices.insert(joinedVertices.end(), part.vertices.begin(), part.vertices.end());
+            partVertices += part.vertices.size();
+        }
+        bool same = canonicalTriangles(vertices, indices) == canonicalTriangles(joinedVertices, joinedIndices);
+
+        size_t bytes32 = indices.size() * sizeof(unsigned int) + vertices.size() * sizeof(Vertex);
+        size_t bytes16 = joinedIndices.size() * sizeof(uint16_t) + partVertices * sizeof(Vertex);
+        printf("  %ux%u: %zu vertices -> %zu parts, %zu vertices (%+.2f%%), %zu -> %zu bytes, %.2f ms%s\n",
+               size.sectors, size.stacks, vertices.size(), parts.size(), partVertices,
+               100.0 * ((double)partVertices - vertices.size()) / vertices.size(), bytes32, bytes16, ms,
+               fits && same ? "" : "  MISMATCH");
+    }
+}
+
+static void reportPacking(const char* label, const std::vector<Vertex>& vertices) {
+    std::vector<PackedVertex> packed(vertices.size());
+    PositionQuantization q = packVertices(vertices.data(), vertices.size(), packed.data());
+    char line[64];
+    snprintf(line, sizeof(line), "  %s", label);
+    printPackingError(line, measurePackingError(vertices.data(), packed.data(), vertices.size(), q), vertices.size());
+}
+
+static void benchPacked() {
+    printf("packed vertices (%zu -> %zu bytes per vertex)\n", sizeof(Vertex), sizeof(PackedVertex));
+
+    // Every finite half must survive half -> float -> half
+    int roundTripFailures = 0;
+    for (unsigned int h = 0; h < 0x10000; ++h) {
+        if ((h & 0x7C00u) == 0x7C00u && (h & 0x03FFu))
+            continue;                                   // NaN payloads are not preserved
+        if (floatToHalf(halfToFloat((uint16_t)h)) != h)
+            ++roundTripFailures;
+    }
+    // Halfway cases round to even: 1 + 2^-11 lies between 1 and the next half
+    bool tiesToEven = floatToHalf(1.0f + 1.0f / 2048.0f) == 0x3C00 &&
+                      floatToHalf(1.0f + 3.0f / 2048.0f) == 0x3C02;
+    printf("  half conversion: %d round-trip failures, ties to even %s\n", roundTripFailures, tiesToEven ? "ok" : "WRONG");
+
+    std::vector<Vertex> vertices(Box<>::vertices.begin(), Box<>::vertices.end());
+    reportPacking("box", vertices);
+
+    std::vector<unsigned int> indices;
+    vertices.clear();
+    createTexturedPyramid(vertices, indices, Vertex{ 0.0f, 0.0f, 0.0f, 0.0f, 0.0f }, 1.0f, 1.0f);
+    reportPacking("pyramid", vertices);
+
+    vertices.clear();
+    indices.clear();
+    createSphereVerticesFast(vertices, indices, 0.5f, 36, 18);
+    reportPacking("sphere 36x18", vertices);
+
+    vertices.clear();
+    indices.clear();
+    createSphereVerticesFast(vertices, indices, 0.5f, 1024, 512);
+    reportPacking("sphere 1024x512", vertices);
+
+    std::vector<PackedVertex> packed(vertices.size());
+    double ms = timeNs([&] {
+        packVertices(vertices.data(), vertices.size(), packed.data());
+        benchSink = packed.back().x;
+    }, 0.25) / 1e6;
+    printf("  pack %zu vertices: %.2f ms (%.1f ns/vertex)\n", vertices.size(), ms, ms * 1e6 / vertices.size());
+}
+
+// world = parent world * local for every node, with no dirty tracking: the cost of a scene graph without it
+static void recomputeAllWorlds(const SceneGraph& graph, std::vector<Mat4>& worlds) {
+    for (uint32_t i = 0; i < graph.size(); ++i) {
+        uint32_t parent = graph.parent(i);
+        if (parent == SceneGraph::kNoParent)
+            worlds[i] = graph.local(i);
+        else
+            multiplyMatrices(graph.local(i), worlds[parent], worlds[i]);
+    }
+}
+
+static void benchSceneGraph() {
+    // 100k nodes, eight children per node (depth 6), each a small rotation and offset from its parent
+    const uint32_t count = 100000;
+    SceneGraph graph;
+    graph.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        Mat4 local;
+        setRotationYMatrix(local, (float)(i % 360));
+        local.m[12] = (float)(i % 8) - 3.5f;
+        local.m[13] = 1.0f;
+        graph.addNode(i == 0 ? SceneGraph::kNoParent : (i - 1) / 8, local);
+    }
+    graph.updateWorldTransforms();
+    printf("scene graph (%u nodes, 8 children per node)\n", count);
+
+    // A changed subset of nodes, the same every run
+    auto pickNodes = [&](uint32_t n) {
+        std::vector<uint32_t> nodes(count);
+        for (uint32_t i = 0; i < count; ++i)
+            nodes[i] = i;
+        std::shuffle(nodes.begin(), nodes.end(), std::mt19937(7));
+        nodes.resize(n);
+        std::sort(nodes.begin(), nodes.end());
+        return nodes;
+    };
+
+    // Dirty propagation must give exactly the matrices of a full recompute
+    std::vector<Mat4> reference(count);
+    std::vector<uint32_t> some = pickNodes(count / 100);
+    for (uint32_t node : some) {
+        Mat4 local = graph.local(node);
+        local.m[14] += 0.25f;
+        graph.setLocal(node, local);
+    }
+    size_t updated = graph.updateWorldTransforms();
+    recomputeAllWorlds(graph, reference);
+    bool same = memcmp(reference.data(), graph.worldMatrices(), count * sizeof(Mat4)) == 0;
+    printf("  1%% of nodes changed: %zu world matrices recomputed (with descendants), %s a full recompute\n",
+           updated, same ? "identical to" : "DIFFERENT from");
+
+    double full = timeNs([&] {
+        recomputeAllWorlds(graph, reference);
+        benchSink = reference.back().m[12];
+    }) / 1e6;
+    std::vector<uint32_t> all = pickNodes(count);
+    for (const std::vector<uint32_t>* changed : { &some, &all }) {
+        double ms = timeNs([&] {
+            for (uint32_t node : *changed)
+                graph.setLocal(node, graph.local(node));
+            graph.updateWorldTransforms();
+            benchSink = graph.world(count - 1).m[12];
+        }) / 1e6;
+        printf("  %-34s %8.3f ms  (%.2fx the speed of a full recompute)\n",
+               changed == &some ? "1% dirty: setLocal + update" : "100% dirty: setLocal + update", ms, full / ms);
+    }
+    double clean = timeNs([&] {
+        benchSink = (float)graph.updateWorldTransforms();
+    }) / 1e6;
+    printf("  %-34s %8.3f ms\n", "nothing dirty: update", clean);
+    printf("  %-34s %8.3f ms  (%.1f ns/node)\n", "full recompute, no dirty flags", full, full * 1e6 / count);
+}
+
+static void benchCulling() {
+    printf("frustum culling (camera in the middle of the scene, 45 degree field of view)\n");
+    printf("  %8s %8s %12s %12s %12s %12s %12s\n", "objects", "visible", "scalar ms", "simd ms", "bvh build", "bvh ms",
+           "bvh nodes");
+    for (size_t count : { (size_t)1000, (size_t)10000, (size_t)100000, (size_t)1000000 }) {
+        // Spheres of radius 0.5 to 1 scattered through a cube with about one per 8 units of volume
+        float half = cbrtf((float)count);
+        std::mt19937 random(3);
+        std::uniform_real_distribution<float> position(-half, half), size(0.5f, 1.0f);
+        std::vector<float> x(count), y(count), z(count), radius(count);
+        std::vector<Aabb> boxes(count);
+        for (size_t i = 0; i < count; ++i) {
+            x[i] = position(random);
+            y[i] = position(random);
+            z[i] = position(random);
+            radius[i] = size(random);
+            boxes[i] = { { x[i], y[i], z[i] }, { radius[i], radius[i], radius[i] } };
+        }
+
+        Mat4 view, projection, viewProjection;
+        setLookAtMatrix(view, 0.0f, 0.0f, 0.0f, 1.0f, 0.75f, 1.0f, 0.0f, 1.0f, 0.0f);
+        setPerspectiveMatrix(projection, 45.0f, 4.0f / 3.0f, 0.1f, 4.0f * half);
+        multiplyMatrices(view, projection, viewProjection);
+        Frustum frustum = extractFrustum(viewProjection);
+
+        std::vector<uint32_t> scalarVisible, simdVisible, bvhVisible;
+        double scalarMs = timeNs([&] {
+            scalarVisible.clear();
+            for (size_t i = 0; i < count; ++i) {
+                if (sphereVisible(frustum, x[i], y[i], z[i], radius[i]))
+                    scalarVisible.push_back((uint32_t)i);
+            }
+        }, 0.1) / 1e6;
+        double simdMs = timeNs([&] {
+            simdVisible.clear();
+            cullSpheres(frustum, x.data(), y.data(), z.data(), radius.data(), count, simdVisible);
+        }, 0.1) / 1e6;
+
+        Bvh bvh;
+        double buildMs = timeNs([&] { bvh.build(boxes.data(), count); }, 0.1) / 1e6;
+        double bvhMs = timeNs([&] { bvh.cull(frustum, bvhVisible); }, 0.1) / 1e6;
+
+        // The BVH culls boxes, so compare it with a brute-force box test
+        size_t boxVisible = 0;
+        for (const Aabb& box : boxes)
+            boxVisible += classifyAabb(frustum, box.center, box.extent) != CullResult::Outside;
+        if (simdVisible != scalarVisible || bvhVisible.size() != boxVisible)
+            printf("  MISMATCH: scalar %zu, simd %zu, boxes %zu, bvh %zu\n", scalarVisible.size(), simdVisible.size(),
+                   boxVisible, bvhVisible.size());
+
+        printf("  %8zu %7.1f%% %12.3f %12.3f %12.2f %12.3f %12zu\n", count, 100.0 * simdVisible.size() / count,
+               scalarMs, simdMs, buildMs, bvhMs, bvh.nodeCount());
+    }
+}
+
+static void benchLod() {
+    // 64x32 sphere chain, 100k spheres of radius 0.5 to 1 spread 2 to 200 units in front of a 1080p camera
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<MeshLod> chain = createSphereLodChain(vertices, indices, 0.5f, 64, 32);
+    printLodChain("sphere LOD chain (64x32 base)", chain);
+
+    const size_t count = 100000;
+    std::mt19937 random(5);
+    std::uniform_real_distribution<float> lateral(-1.0f, 1.0f), distance(2.0f, 200.0f), size(1.0f, 2.0f);
+    std::vector<float> x(count), y(count), z(count), scale(count);
+    for (size_t i = 0; i < count; ++i) {
+        z[i] = -distance(random);
+        x[i] = lateral(random) * -z[i] * 0.4f;
+        y[i] = lateral(random) * -z[i] * 0.3f;
+        scale[i] = size(random);
+    }
+    Mat4 projection;
+    setPerspectiveMatrix(projection, 45.0f, 16.0f / 9.0f, 0.1f, 500.0f);
+
+    // The camera sways back and forth by half a unit, as a hand-held one might: without
+    // hysteresis every sphere near a threshold switches level on each swing
+    const int frames = 200;
+    for (float hysteresis : { 0.0f, 0.25f }) {
+        LodSelector selector;
+        selector.create(chain, count, 1.0f, hysteresis);
+        Mat4 view;
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < frames; ++frame) {
+            float cameraZ = 0.5f * sinf(frame * 0.7f);
+            setLookAtMatrix(view, 0.0f, 0.0f, cameraZ, 0.0f, 0.0f, cameraZ - 1.0f, 0.0f, 1.0f, 0.0f);
+            selector.beginFrame(projection, 1080);
+            for (size_t i = 0; i < count; ++i)
+                benchSink = (float)selector.select(i, viewDepth(view, x[i], y[i], z[i]), scale[i]);
+            selector.endFrame();
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        char label[64];
+        snprintf(label, sizeof(label), "  hysteresis %.2f", hysteresis);
+        selector.printReport(label);
+        printf("  %.1f ns per selection\n", elapsed.count() / ((double)frames * count));
+    }
+}
+
+// Distance from the origin to the closest point of triangle abc (Ericson, Real-Time Collision Detection 5.1.5)
+static double originToTriangle(const Vertex& va, const Vertex& vb, const Vertex& vc) {
+    const double a[3] = { va.x, va.y, va.z }, b[3] = { vb.x, vb.y, vb.z }, c[3] = { vc.x, vc.y, vc.z };
+    auto dot = [](const double* u, const double* v) { return u[0] * v[0] + u[1] * v[1] + u[2] * v[2]; };
+    auto length = [](double x, double y, double z) { return sqrt(x * x + y * y + z * z); };
+    double ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] }, ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+    double ap[3] = { -a[0], -a[1], -a[2] }, bp[3] = { -b[0], -b[1], -b[2] }, cp[3] = { -c[0], -c[1], -c[2] };
+    double d1 = dot(ab, ap), d2 = dot(ac, ap);
+    if (d1 <= 0 && d2 <= 0)
+        return length(a[0], a[1], a[2]);
+    double d3 = dot(ab, bp), d4 = dot(ac, bp);
+    if (d3 >= 0 && d4 <= d3)
+        return length(b[0], b[1], b[2]);
+    double vc_ = d1 * d4 - d3 * d2;
+    if (vc_ <= 0 && d1 >= 0 && d3 <= 0) {
+        double t = d1 / (d1 - d3);
+        return length(a[0] + t * ab[0], a[1] + t * ab[1], a[2] + t * ab[2]);
+    }
+    double d5 = dot(ab, cp), d6 = dot(ac, cp);
+    if (d6 >= 0 && d5 <= d6)
+        return length(c[0], c[1], c[2]);
+    double vb_ = d5 * d2 - d1 * d6;
+    if (vb_ <= 0 && d2 >= 0 && d6 <= 0) {
+        double t = d2 / (d2 - d6);
+        return length(a[0] + t * ac[0], a[1] + t * ac[1], a[2] + t * ac[2]);
+    }
+    double va_ = d3 * d6 - d5 * d4;
+    if (va_ <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0) {
+        double t = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        return length(b[0] + t * (c[0] - b[0]), b[1] + t * (c[1] - b[1]), b[2] + t * (c[2] - b[2]));
+    }
+    double denominator = 1.0 / (va_ + vb_ + vc_);
+    double v = vb_ * denominator, w = vc_ * denominator;
+    return length(a[0] + ab[0] * v + ac[0] * w, a[1] + ab[1] * v + ac[1] * w, a[2] + ab[2] * v + ac[2] * w);
+}
+
+// Largest distance between a tessellated sphere and the true sphere (vertices lie on it, so the mesh is inside)
+static double maxSphereDeviation(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+                                 float radius) {
+    double deviation = 0.0;
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        double distance = originToTriangle(vertices[indices[t]], vertices[indices[t + 1]], vertices[indices[t + 2]]);
+        deviation = std::max(deviation, radius - distance);
+    }
+    return deviation;
+}
+
+static void benchIcosphere() {
+    // Radius 1, so errors are relative to the radius. UV spheres use twice as many sectors as stacks.
+    printf("icosphere vs stack/sector sphere (radius 1, measured largest deviation)\n");
+    printf("  %-16s %9s %9s %12s %12s\n", "mesh", "triangles", "vertices", "max error", "build ms");
+    auto uvSphere = [](unsigned int stacks, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+        vertices.clear();
+        indices.clear();
+        createSphereVertices(vertices, indices, 1.0f, 2 * stacks, stacks);
+    };
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    for (unsigned int stacks : { 4u, 8u, 16u, 32u, 64u, 128u }) {
+        uvSphere(stacks, vertices, indices);
+        double ms = timeNs([&] { uvSphere(stacks, vertices, indices); }, 0.05) / 1e6;
+        char name[32];
+        snprintf(name, sizeof(name), "uv %ux%u", 2 * stacks, stacks);
+        printf("  %-16s %9zu %9zu %12.6f %12.3f\n", name, indices.size() / 3, vertices.size(),
+               maxSphereDeviation(vertices, indices, 1.0f), ms);
+    }
+
+    // For each icosphere, the smallest UV sphere with no more error
+    std::vector<double> uvError(1, 1.0), uvTriangles(1, 0.0);
+    auto smallestUvWithin = [&](double error) {
+        unsigned int stacks = 2;
+        for (;; ++stacks) {
+            if (stacks >= uvError.size()) {
+                uvSphere(stacks, vertices, indices);
+                uvError.resize(stacks + 1, 1.0);
+                uvTriangles.resize(stacks + 1, 0.0);
+                uvError[stacks] = maxSphereDeviation(vertices, indices, 1.0f);
+                uvTriangles[stacks] = indices.size() / 3.0;
+            }
+            if (uvError[stacks] <= error)
+                return stacks;
+        }
+    };
+    uvError.resize(2, 1.0);
+    uvTriangles.resize(2, 0.0);
+    for (unsigned int subdivisions = 0; subdivisions <= 6; ++subdivisions) {
+        vertices.clear();
+        indices.clear();
+        createIcosphereVertices(vertices, indices, 1.0f, subdivisions);
+        double ms = timeNs([&] {
+            std::vector<Vertex> v;
+            std::vector<unsigned int> i;
+            createIcosphereVertices(v, i, 1.0f, subdivisions);
+            benchSink = v.back().x;
+        }, 0.05) / 1e6;
+        double error = maxSphereDeviation(vertices, indices, 1.0f);
+        size_t triangles = indices.size() / 3;
+        char name[32];
+        snprintf(name, sizeof(name), "ico %u", subdivisions);
+        printf("  %-16s %9zu %9zu %12.6f %12.3f", name, triangles, vertices.size(), error, ms);
+        if (subdivisions >= 1) {
+            unsigned int stacks = smallestUvWithin(error);
+            printf("   same error as uv %ux%u: %.0f triangles (%.2fx)", 2 * stacks, stacks, uvTriangles[stacks],
+                   uvTriangles[stacks] / triangles);
+        }
+        printf("\n");
+    }
+}
+
+struct Benchmark {
+    const char* name;
+    void (*run)();
+};
+
+static const Benchmark benchmarks[] = {
+    { "math", benchMath },
+    { "sphere", benchSphere },
+    { "static_mesh", benchStaticMesh },
+    { "weld", benchWeld },
+    { "vcache", benchVertexCache },
+    { "split", benchSplit },
+    { "packed", benchPacked },
+    { "scene_graph", benchSceneGraph },
+    { "culling", benchCulling },
+    { "lod", benchLod },
+    { "icosphere", benchIcosphere },
+};
+
+int main(int argc, char* argv[]) {
+    int ran = 0;
+    for (const Benchmark& b : benchmarks) {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc; ++i) {
+            if (strcmp(argv[i], b.name) == 0)
+                selected = true;
+        }
+        if (selected) {
+            b.run();
+            ++ran;
+        }
+    }
+    if (ran == 0) {
+        fprintf(stderr, "Unknown benchmark. Available:");
+        for (const Benchmark& b : benchmarks)
+            fprintf(stderr, " %s", b.name);
+        fprintf(stderr, "\n");
+        return 1;
+    }
+    return 0;
+}
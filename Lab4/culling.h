@@ -0,0 +1,310 @@
+#pragma once
+
+// View-frustum culling (--cull in the demos, "culling" in bench.cpp).
+//
+// Frustum planes are extracted from view * projection (Gribb & Hartmann) and
+// kept as parallel arrays, padded from six planes to eight, so one SSE or AVX
+// pass tests a box or sphere against several planes at once. Bounds are
+// center + half-extent boxes and spheres in world space.
+//
+// Bvh groups objects into a binary tree of boxes (median split along the
+// longest axis, up to kBvhLeafSize objects per leaf). Culling walks the tree
+// and drops whole subtrees outside a plane. Subtrees entirely inside the
+// frustum are accepted without testing their objects one by one. cullSpheres
+// is the brute-force alternative for small or constantly moving sets: it
+// tests four (eight with AVX) spheres per iteration.
+
+#include "math3d.h"
+#include "vertex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+// Axis-aligned box as center and half-extent
+struct Aabb {
+    float center[3];
+    float extent[3];
+};
+
+// Box around count vertex positions
+inline Aabb computeAabb(const Vertex* vertices, size_t count) {
+    float lo[3] = { INFINITY, INFINITY, INFINITY }, hi[3] = { -INFINITY, -INFINITY, -INFINITY };
+    for (size_t i = 0; i < count; ++i) {
+        const float p[3] = { vertices[i].x, vertices[i].y, vertices[i].z };
+        for (int a = 0; a < 3; ++a) {
+            lo[a] = std::min(lo[a], p[a]);
+            hi[a] = std::max(hi[a], p[a]);
+        }
+    }
+    Aabb box;
+    for (int a = 0; a < 3; ++a) {
+        box.center[a] = count ? (lo[a] + hi[a]) * 0.5f : 0.0f;
+        box.extent[a] = count ? (hi[a] - lo[a]) * 0.5f : 0.0f;
+    }
+    return box;
+}
+
+// Radius of the smallest origin-centered sphere around count vertices; it stays valid
+// under any rotation about the origin, so animated instances can keep their bounds
+inline float computeBoundingRadius(const Vertex* vertices, size_t count) {
+    float radiusSquared = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        const Vertex& v = vertices[i];
+        radiusSquared = std::max(radiusSquared, v.x * v.x + v.y * v.y + v.z * v.z);
+    }
+    return sqrtf(radiusSquared);
+}
+
+// Frustum planes a*x + b*y + c*z + d >= 0 (inside), normalized, as parallel arrays:
+// left, right, bottom, top, near, far, then two padding planes that accept everything
+struct Frustum {
+    alignas(32) float a[8];
+    alignas(32) float b[8];
+    alignas(32) float c[8];
+    alignas(32) float d[8];
+};
+
+// Planes of the clip volume of viewProjection (multiplyMatrices(view, projection, viewProjection)),
+// in the space of the points it transforms: world space for view * projection
+inline Frustum extractFrustum(const Mat4& viewProjection) {
+    // Row r of the matrix in GL terms is m[r], m[4 + r], m[8 + r], m[12 + r]
+    const float* m = viewProjection.m;
+    auto row = [m](int r, int i) { return m[i * 4 + r]; };
+    Frustum frustum;
+    for (int plane = 0; plane < 6; ++plane) {
+        int axis = plane / 2;
+        float sign = (plane % 2 == 0) ? 1.0f : -1.0f;  // w + x >= 0 (left), w - x >= 0 (right), ...
+        float p[4];
+        for (int i = 0; i < 4; ++i)
+            p[i] = row(3, i) + sign * row(axis, i);
+        float length = sqrtf(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+        frustum.a[plane] = p[0] / length;
+        frustum.b[plane] = p[1] / length;
+        frustum.c[plane] = p[2] / length;
+        frustum.d[plane] = p[3] / length;
+    }
+    for (int plane = 6; plane < 8; ++plane) {
+        frustum.a[plane] = frustum.b[plane] = frustum.c[plane] = 0.0f;
+        frustum.d[plane] = 1.0f;
+    }
+    return frustum;
+}
+
+enum class CullResult { Outside, Intersects, Inside };
+
+// Box against all planes: outside one of them, inside all of them, or neither
+inline CullResult classifyAabb(const Frustum& frustum, const float center[3], const float extent[3]) {
+#if defined(MATH3D_SSE)
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    __m128 cx = _mm_set1_ps(center[0]), cy = _mm_set1_ps(center[1]), cz = _mm_set1_ps(center[2]);
+    __m128 ex = _mm_set1_ps(extent[0]), ey = _mm_set1_ps(extent[1]), ez = _mm_set1_ps(extent[2]);
+    int outside = 0, crossing = 0;
+    for (int i = 0; i < 8; i += 4) {
+        __m128 a = _mm_load_ps(frustum.a + i), b = _mm_load_ps(frustum.b + i), c = _mm_load_ps(frustum.c + i);
+        __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, cx), _mm_mul_ps(b, cy)),
+                                     _mm_add_ps(_mm_mul_ps(c, cz), _mm_load_ps(frustum.d + i)));
+        // Projected half-size of the box onto the plane normal: |a| ex + |b| ey + |c| ez
+        __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, a), ex),
+                                              _mm_mul_ps(_mm_andnot_ps(signMask, b), ey)),
+                                   _mm_mul_ps(_mm_andnot_ps(signMask, c), ez));
+        outside |= _mm_movemask_ps(_mm_cmplt_ps(distance, _mm_xor_ps(radius, signMask)));
+        crossing |= _mm_movemask_ps(_mm_cmplt_ps(distance, radius));
+    }
+#else
+    int outside = 0, crossing = 0;
+    for (int i = 0; i < 6; ++i) {
+        float distance = frustum.a[i] * center[0] + frustum.b[i] * center[1] + frustum.c[i] * center[2] + frustum.d[i];
+        float radius = fabsf(frustum.a[i]) * extent[0] + fabsf(frustum.b[i]) * extent[1] +
+                       fabsf(frustum.c[i]) * extent[2];
+        outside |= distance < -radius;
+        crossing |= distance < radius;
+    }
+#endif
+    if (outside)
+        return CullResult::Outside;
+    return crossing ? CullResult::Intersects : CullResult::Inside;
+}
+
+// One sphere, plane by plane (the reference for cullSpheres)
+inline bool sphereVisible(const Frustum& frustum, float x, float y, float z, float radius) {
+    for (int i = 0; i < 6; ++i) {
+        // Summed in the same order as the SIMD path, so both agree exactly
+        if ((frustum.a[i] * x + frustum.b[i] * y) + (frustum.c[i] * z + frustum.d[i]) < -radius)
+            return false;
+    }
+    return true;
+}
+
+// Indices of the spheres (parallel arrays x, y, z, radius) that are not entirely outside the frustum,
+// appended to visible in increasing order; returns how many were added
+inline size_t cullSpheres(const Frustum& frustum, const float* x, const float* y, const float* z, const float* radius,
+                          size_t count, std::vector<uint32_t>& visible) {
+    size_t before = visible.size();
+    size_t i = 0;
+#if defined(MATH3D_AVX)
+    for (; i + 8 <= count; i += 8) {
+        __m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+        __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(radius + i));
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p) {
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(frustum.a[p]), px),
+                                                          _mm256_mul_ps(_mm256_set1_ps(frustum.b[p]), py)),
+                                            _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(frustum.c[p]), pz),
+                                                          _mm256_set1_ps(frustum.d[p])));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+        }
+        int mask = _mm256_movemask_ps(inside);
+        for (int lane = 0; lane < 8; ++lane) {
+            if (mask & (1 << lane))
+                visible.push_back((uint32_t)(i + lane));
+        }
+    }
+#elif defined(MATH3D_SSE)
+    for (; i + 4 <= count; i += 4) {
+        __m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+        __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+        __m128 inside = _mm_cmpeq_ps(px, px);           // All ones (positions are never NaN)
+        for (int p = 0; p < 6; ++p) {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(frustum.a[p]), px),
+                                                    _mm_mul_ps(_mm_set1_ps(frustum.b[p]), py)),
+                                         _mm_add_ps(_mm_mul_ps(_mm_set1_ps(frustum.c[p]), pz),
+                                                    _mm_set1_ps(frustum.d[p])));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+        }
+        int mask = _mm_movemask_ps(inside);
+        for (int lane = 0; lane < 4; ++lane) {
+            if (mask & (1 << lane))
+                visible.push_back((uint32_t)(i + lane));
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        if (sphereVisible(frustum, x[i], y[i], z[i], radius[i]))
+            visible.push_back((uint32_t)i);
+    }
+    return visible.size() - before;
+}
+
+const unsigned int kBvhLeafSize = 4;
+
+struct BvhCullStats {
+    size_t nodesTested = 0;
+    size_t objectsTested = 0;     // Objects in leaves that straddle a plane
+};
+
+class Bvh {
+public:
+    // Build over count object boxes; object i keeps index i in the results of cull
+    void build(const Aabb* bounds, size_t count) {
+        nodes.clear();
+        objects.assign(count, 0);
+        std::iota(objects.begin(), objects.end(), 0u);
+        boxes.assign(bounds, bounds + count);
+        if (count == 0)
+            return;
+        nodes.reserve(2 * (count / kBvhLeafSize + 1));
+        buildNode(0, (uint32_t)count);
+
+        // Leaf tests read boxes in tree order
+        std::vector<Aabb> ordered(count);
+        for (size_t i = 0; i < count; ++i)
+            ordered[i] = boxes[objects[i]];
+        boxes.swap(ordered);
+    }
+
+    // Replace visible with the objects whose boxes are not entirely outside the frustum; returns their count
+    size_t cull(const Frustum& frustum, std::vector<uint32_t>& visible, BvhCullStats* stats = nullptr) const {
+        visible.clear();
+        if (nodes.empty())
+            return 0;
+        BvhCullStats counters;
+        uint32_t stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            uint32_t index = stack[--top];
+            const Node& node = nodes[index];
+            ++counters.nodesTested;
+            CullResult result = classifyAabb(frustum, node.center, node.extent);
+            if (result == CullResult::Outside)
+                continue;
+            if (result == CullResult::Inside) {
+                visible.insert(visible.end(), objects.begin() + node.begin, objects.begin() + node.end);
+                continue;
+            }
+            if (node.right == 0) {
+                for (uint32_t i = node.begin; i < node.end; ++i) {
+                    ++counters.objectsTested;
+                    if (classifyAabb(frustum, boxes[i].center, boxes[i].extent) != CullResult::Outside)
+                        visible.push_back(objects[i]);
+                }
+                continue;
+            }
+            stack[top++] = node.right;
+            stack[top++] = index + 1;     // Left child follows its parent
+        }
+        if (stats)
+            *stats = counters;
+        return visible.size();
+    }
+
+    size_t nodeCount() const { return nodes.size(); }
+
+private:
+    // Node boxes cover objects[begin, end); interior nodes have children index + 1 and right, leaves right == 0
+    struct Node {
+        float center[3];
+        uint32_t begin;
+        float extent[3];
+        uint32_t end;
+        uint32_t right;
+    };
+
+    uint32_t buildNode(uint32_t begin, uint32_t end) {
+        float lo[3] = { INFINITY, INFINITY, INFINITY }, hi[3] = { -INFINITY, -INFINITY, -INFINITY };
+        float centerLo[3] = { INFINITY, INFINITY, INFINITY }, centerHi[3] = { -INFINITY, -INFINITY, -INFINITY };
+        for (uint32_t i = begin; i < end; ++i) {
+            const Aabb& box = boxes[objects[i]];
+            for (int a = 0; a < 3; ++a) {
+                lo[a] = std::min(lo[a], box.center[a] - box.extent[a]);
+                hi[a] = std::max(hi[a], box.center[a] + box.extent[a]);
+                centerLo[a] = std::min(centerLo[a], box.center[a]);
+                centerHi[a] = std::max(centerHi[a], box.center[a]);
+            }
+        }
+
+        uint32_t index = (uint32_t)nodes.size();
+        nodes.push_back({});
+        Node& node = nodes.back();
+        for (int a = 0; a < 3; ++a) {
+            node.center[a] = (lo[a] + hi[a]) * 0.5f;
+            node.extent[a] = (hi[a] - lo[a]) * 0.5f;
+        }
+        node.begin = begin;
+        node.end = end;
+        node.right = 0;
+        if (end - begin <= kBvhLeafSize)
+            return index;
+
+        // Median split along the axis where the object centers spread furthest
+        int axis = 0;
+        for (int a = 1; a < 3; ++a) {
+            if (centerHi[a] - centerLo[a] > centerHi[axis] - centerLo[axis])
+                axis = a;
+        }
+        uint32_t middle = begin + (end - begin) / 2;
+        std::nth_element(objects.begin() + begin, objects.begin() + middle, objects.begin() + end,
+                         [&](uint32_t x, uint32_t y) { return boxes[x].center[axis] < boxes[y].center[axis]; });
+        buildNode(begin, middle);
+        uint32_t right = buildNode(middle, end);
+        nodes[index].right = right;     // nodes may have grown; node is stale
+        return index;
+    }
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> objects;  // Object indices in tree order
+    std::vector<Aabb> boxes;        // Object boxes (by object index while building, in tree order after)
+};
@@ -0,0 +1,371 @@
+#pragma once
+
+// Frame profiler for the render loops (--profile).
+//
+// ProfileScope times one stage of a frame (clear, uniforms, draw, swap...) on
+// the CPU and, unless told otherwise, on the GPU with a GL_TIME_ELAPSED query
+// pair. GPU results are collected kProfileFramesInFlight frames later, when
+// they are normally available, so reading them never stalls the pipeline.
+// Every result becomes a ProfileEvent in a fixed-size lock-free ring (the
+// oldest events are overwritten), so recording never blocks.
+// Scopes belong to the thread that owns the GL context. On exit,
+// writeChromeTrace saves the ring as Chrome trace JSON (chrome://tracing or
+// ui.perfetto.dev) and printReport prints p50/p95/p99 per stage plus a
+// frame-time histogram.
+//
+// Disabled (the default), a scope costs one predictable branch. GL queries
+// cannot nest, so a GPU scope inside another GPU scope is timed on the CPU only.
+// Like ShaderProgram, the destructor makes no GL calls; call destroy() while
+// the context exists.
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+// How many frames GPU timer queries are left to complete before being read
+const unsigned int kProfileFramesInFlight = 4;
+
+enum class ProfileTrack : uint8_t { Cpu, Gpu };
+
+struct ProfileEvent {
+    uint64_t startNs;       // Since FrameProfiler::enable; GPU events start with their CPU scope
+    uint64_t durationNs;
+    uint32_t frame;
+    uint16_t stage;         // Index into the profiler's stage names
+    ProfileTrack track;
+    uint8_t thread;         // Small per-thread number, 0 for the first thread to record
+};
+
+// Multi-producer ring of events. push claims a slot with one atomic increment
+// and publishes it with a sequence number; readers (after the producers are
+// done, e.g. on exit) keep only slots written on the latest lap.
+class ProfileEventRing {
+public:
+    void reset(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity)
+            size *= 2;
+        slots.reset(new Slot[size]);
+        mask = size - 1;
+        head.store(0, std::memory_order_relaxed);
+    }
+
+    void push(const ProfileEvent& event) {
+        uint64_t index = head.fetch_add(1, std::memory_order_relaxed);
+        Slot& slot = slots[index & mask];
+        slot.event = event;
+        slot.sequence.store(index + 1, std::memory_order_release);
+    }
+
+    // Events still in the ring, oldest first
+    std::vector<ProfileEvent> snapshot() const {
+        std::vector<ProfileEvent> events;
+        if (!slots)
+            return events;
+        uint64_t end = head.load(std::memory_order_acquire);
+        uint64_t begin = end > mask + 1 ? end - (mask + 1) : 0;
+        events.reserve((size_t)(end - begin));
+        for (uint64_t index = begin; index < end; ++index) {
+            const Slot& slot = slots[index & mask];
+            if (slot.sequence.load(std::memory_order_acquire) == index + 1)
+                events.push_back(slot.event);
+        }
+        return events;
+    }
+
+    uint64_t pushed() const { return head.load(std::memory_order_relaxed); }
+    size_t capacity() const { return slots ? mask + 1 : 0; }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> sequence{ 0 };
+        ProfileEvent event;
+    };
+    std::unique_ptr<Slot[]> slots;
+    size_t mask = 0;
+    std::atomic<uint64_t> head{ 0 };
+};
+
+class FrameProfiler {
+public:
+    FrameProfiler() = default;
+    FrameProfiler(const FrameProfiler&) = delete;
+    FrameProfiler& operator=(const FrameProfiler&) = delete;
+
+    // Start recording into a ring of capacity events. gpuTimers needs a current GL context.
+    void enable(size_t capacity = 1 << 18, bool gpuTimers = true) {
+        events.reset(capacity);
+        gpuEnabled = gpuTimers;
+        origin = Clock::now();
+        active = true;
+    }
+
+    bool enabled() const { return active; }
+
+    // Collect GPU results from kProfileFramesInFlight frames ago; call at the top of each frame
+    void beginFrame() {
+        if (!active)
+            return;
+        frameStart = nowNs();
+        if (gpuEnabled)
+            collect(frameQueries[frame % kProfileFramesInFlight]);
+    }
+
+    void endFrame() {
+        if (!active)
+            return;
+        uint64_t end = nowNs();
+        events.push({ frameStart, end - frameStart, frame, stageIndex("frame"), ProfileTrack::Cpu, threadNumber() });
+        ++frame;
+    }
+
+    // Used by ProfileScope; gpu is false for stages that issue no GL work worth timing (swap, polling)
+    uint64_t beginStage(bool gpu, bool& gpuStarted) {
+        gpuStarted = false;
+        if (gpu && gpuEnabled && !gpuScopeOpen) {
+            PendingQuery pending;
+            pending.query = acquireQuery();
+            glBeginQuery(GL_TIME_ELAPSED, pending.query);
+            gpuScopeOpen = true;
+            gpuStarted = true;
+            frameQueries[frame % kProfileFramesInFlight].push_back(pending);
+        }
+        return nowNs();
+    }
+
+    void endStage(const char* name, uint64_t startNs, bool gpuStarted) {
+        uint64_t end = nowNs();
+        uint16_t stage = stageIndex(name);
+        events.push({ startNs, end - startNs, frame, stage, ProfileTrack::Cpu, threadNumber() });
+        if (gpuStarted) {
+            glEndQuery(GL_TIME_ELAPSED);
+            gpuScopeOpen = false;
+            PendingQuery& pending = frameQueries[frame % kProfileFramesInFlight].back();
+            pending.stage = stage;
+            pending.startNs = startNs;
+            pending.frame = frame;
+        }
+    }
+
+    // Read what is still outstanding (waiting for the GPU) and delete the queries
+    void destroy() {
+        if (gpuEnabled) {
+            glFinish();
+            for (unsigned int i = 1; i <= kProfileFramesInFlight; ++i)
+                collect(frameQueries[(frame + i) % kProfileFramesInFlight]);
+            if (!freeQueries.empty())
+                glDeleteQueries((GLsizei)freeQueries.size(), freeQueries.data());
+            freeQueries.clear();
+        }
+        gpuEnabled = false;
+        active = false;
+    }
+
+    // Chrome trace event format: one complete ("X") event per record, CPU threads and the GPU as tracks
+    bool writeChromeTrace(const char* path) const {
+        FILE* file = fopen(path, "w");
+        if (!file)
+            return false;
+        fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"GPU\"}}",
+                kGpuTrackId);
+        for (const ProfileEvent& event : events.snapshot()) {
+            bool gpu = event.track == ProfileTrack::Gpu;
+            fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+                          "\"dur\":%.3f,\"args\":{\"frame\":%u}}",
+                    stageNames[event.stage].c_str(), gpu ? "gpu" : "cpu", gpu ? kGpuTrackId : event.thread,
+                    event.startNs / 1000.0, event.durationNs / 1000.0, event.frame);
+        }
+        fprintf(file, "\n]}\n");
+        return fclose(file) == 0;
+    }
+
+    void printReport(const char* label) const {
+        std::vector<ProfileEvent> recorded = events.snapshot();
+        printf("%s: %u frames, %zu events kept of %llu recorded\n", label, frame, recorded.size(),
+               (unsigned long long)events.pushed());
+        printf("  %-12s %-4s %7s %9s %9s %9s\n", "stage", "", "count", "p50 ms", "p95 ms", "p99 ms");
+        std::vector<double> durations;
+        for (uint16_t stage = 0; stage < stageNames.size(); ++stage) {
+            for (ProfileTrack track : { ProfileTrack::Cpu, ProfileTrack::Gpu }) {
+                durations.clear();
+                for (const ProfileEvent& event : recorded) {
+                    if (event.stage == stage && event.track == track)
+                        durations.push_back(event.durationNs / 1e6);
+                }
+                if (durations.empty())
+                    continue;
+                std::sort(durations.begin(), durations.end());
+                printf("  %-12s %-4s %7zu %9.3f %9.3f %9.3f\n", stageNames[stage].c_str(),
+                       track == ProfileTrack::Gpu ? "gpu" : "cpu", durations.size(), percentile(durations, 0.50),
+                       percentile(durations, 0.95), percentile(durations, 0.99));
+            }
+        }
+
+        // Frame times in doubling buckets, 1 ms up to 64 ms and beyond
+        durations.clear();
+        for (const ProfileEvent& event : recorded) {
+            if (stageNames[event.stage] == "frame")
+                durations.push_back(event.durationNs / 1e6);
+        }
+        if (durations.empty())
+            return;
+        const int bucketCount = 8;
+        size_t buckets[bucketCount] = {};
+        for (double ms : durations) {
+            int bucket = 0;
+            while (bucket < bucketCount - 1 && ms >= (double)(1 << bucket))
+                ++bucket;
+            ++buckets[bucket];
+        }
+        size_t largest = *std::max_element(buckets, buckets + bucketCount);
+        printf("  frame time histogram:\n");
+        for (int bucket = 0; bucket < bucketCount; ++bucket) {
+            char range[32];
+            if (bucket == 0)
+                snprintf(range, sizeof(range), "< 1 ms");
+            else if (bucket == bucketCount - 1)
+                snprintf(range, sizeof(range), ">= %d ms", 1 << (bucket - 1));
+            else
+                snprintf(range, sizeof(range), "%d-%d ms", 1 << (bucket - 1), 1 << bucket);
+            int bar = (int)(40 * buckets[bucket] / largest);
+            printf("  %10s %7zu %s\n", range, buckets[bucket], std::string((size_t)bar, '#').c_str());
+        }
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static const int kGpuTrackId = 1000;
+
+    struct StageAlias {
+        const char* name;
+        uint16_t stage;
+    };
+
+    struct PendingQuery {
+        GLuint query = 0;
+        uint16_t stage = 0;
+        uint64_t startNs = 0;
+        uint32_t frame = 0;
+    };
+
+    static double percentile(const std::vector<double>& sorted, double fraction) {
+        size_t index = (size_t)(fraction * (sorted.size() - 1) + 0.5);
+        return sorted[std::min(index, sorted.size() - 1)];
+    }
+
+    static uint8_t threadNumber() {
+        static std::atomic<unsigned int> next{ 0 };
+        thread_local uint8_t number = (uint8_t)next.fetch_add(1, std::memory_order_relaxed);
+        return number;
+    }
+
+    uint64_t nowNs() const {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - origin).count();
+    }
+
+    // Stage names are few; look them up by pointer first (callers pass literals), then by text
+    uint16_t stageIndex(const char* name) {
+        for (const StageAlias& alias : stageAliases) {
+            if (alias.name == name)
+                return alias.stage;
+        }
+        uint16_t stage = 0;
+        while (stage < stageNames.size() && stageNames[stage] != name)
+            ++stage;
+        if (stage == stageNames.size())
+            stageNames.push_back(name);
+        stageAliases.push_back({ name, stage });
+        return stage;
+    }
+
+    GLuint acquireQuery() {
+        if (freeQueries.empty()) {
+            GLuint queries[16];
+            glGenQueries(16, queries);
+            freeQueries.assign(queries, queries + 16);
+        }
+        GLuint query = freeQueries.back();
+        freeQueries.pop_back();
+        return query;
+    }
+
+    // Turn finished queries into GPU events; ones still running are dropped rather than waited for
+    void collect(std::vector<PendingQuery>& pending) {
+        for (const PendingQuery& entry : pending) {
+            GLuint available = 0;
+            glGetQueryObjectuiv(entry.query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint64 elapsed = 0;
+                glGetQueryObjectui64v(entry.query, GL_QUERY_RESULT, &elapsed);
+                events.push({ entry.startNs, elapsed, entry.frame, entry.stage, ProfileTrack::Gpu, 0 });
+            }
+            freeQueries.push_back(entry.query);
+        }
+        pending.clear();
+    }
+
+    bool active = false;
+    bool gpuEnabled = false;
+    bool gpuScopeOpen = false;
+    Clock::time_point origin;
+    uint64_t frameStart = 0;
+    uint32_t frame = 0;
+    ProfileEventRing events;
+    std::vector<std::string> stageNames;
+    std::vector<StageAlias> stageAliases;
+    std::vector<PendingQuery> frameQueries[kProfileFramesInFlight];
+    std::vector<GLuint> freeQueries;
+};
+
+// Times the enclosing block as one stage of the current frame
+class ProfileScope {
+public:
+    ProfileScope(FrameProfiler& profiler, const char* name, bool gpu = true) {
+        if (!profiler.enabled())
+            return;
+        this->profiler = &profiler;
+        this->name = name;
+        startNs = profiler.beginStage(gpu, gpuStarted);
+    }
+
+    ~ProfileScope() { end(); }
+
+    // Close the scope before it goes out of scope
+    void end() {
+        if (profiler)
+            profiler->endStage(name, startNs, gpuStarted);
+        profiler = nullptr;
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    FrameProfiler* profiler = nullptr;
+    const char* name = nullptr;
+    uint64_t startNs = 0;
+    bool gpuStarted = false;
+};
+
+// beginFrame/endFrame around one iteration of a render loop, including iterations left with continue
+class ProfileFrame {
+public:
+    explicit ProfileFrame(FrameProfiler& profiler) : profiler(profiler) { profiler.beginFrame(); }
+    ~ProfileFrame() { profiler.endFrame(); }
+
+    ProfileFrame(const ProfileFrame&) = delete;
+    ProfileFrame& operator=(const ProfileFrame&) = delete;
+
+private:
+    FrameProfiler& profiler;
+};
@@ -0,0 +1,262 @@
+#pragma once
+
+// Upload path for indexed Vertex meshes.
+//
+// Indices are stored as GL_UNSIGNED_SHORT whenever the vertex count allows it
+// (at most 65535 vertices, so 0xFFFF stays free for primitive restart) and as
+// GL_UNSIGNED_INT otherwise. Meshes that are too big for 16-bit indices can be
+// cut into parts first with splitMesh (mesh_opt.h) and uploaded part by part.
+// uploadPackedMesh stores 12-byte PackedVertex data instead of 20-byte Vertex;
+// the vertex shader then needs the positionScale/positionOffset uniforms.
+// uploadVertexLayers adds a second vertex stream with a texture array layer
+// per vertex, so multi-material meshes can be drawn in one call.
+// An InstanceBuffer holds a model matrix and layer per instance; bound to a
+// mesh with bindInstances, drawMeshInstanced draws every instance in one call.
+// Several meshes (such as levels of detail) can share one upload, each drawn
+// from its own first index and base vertex with drawMeshInstancedRange.
+
+#include <glad/glad.h>
+#include "packed_vertex.h"
+#include "shader_program.h"
+#include "vertex.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Passed as restartIndex when the index buffer has no primitive restarts
+const unsigned int NO_RESTART_INDEX = 0u;
+
+// Largest vertex count that is drawn with 16-bit indices
+const size_t MAX_VERTICES_16BIT = 0xFFFF;
+
+// VAO with its vertex and index buffers. Draw offsets are in indices, not bytes.
+struct GpuMesh {
+    unsigned int vao = 0, vbo = 0, ebo = 0;
+    unsigned int layerVbo = 0;                      // Only with uploadVertexLayers
+    GLenum indexType = GL_UNSIGNED_INT;
+    size_t indexSize = sizeof(unsigned int);
+    size_t vertexCount = 0, indexCount = 0;
+    unsigned int restartIndex = NO_RESTART_INDEX;   // Already converted to the index type
+    PositionQuantization quantization;              // Identity unless the vertices are packed
+};
+
+// Fill the bound EBO, as 16-bit when the mesh's vertex count allows it
+inline void uploadMeshIndices(GpuMesh& mesh, const unsigned int* indices, size_t indexCount, unsigned int restartIndex) {
+    bool hasRestart = restartIndex != NO_RESTART_INDEX;
+    mesh.indexCount = indexCount;
+    if (mesh.vertexCount <= MAX_VERTICES_16BIT) {
+        std::vector<uint16_t> shortIndices(indexCount);
+        for (size_t i = 0; i < indexCount; ++i)
+            shortIndices[i] = hasRestart && indices[i] == restartIndex ? 0xFFFF : (uint16_t)indices[i];
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(uint16_t), shortIndices.data(), GL_STATIC_DRAW);
+        mesh.indexType = GL_UNSIGNED_SHORT;
+        mesh.indexSize = sizeof(uint16_t);
+        mesh.restartIndex = hasRestart ? 0xFFFF : NO_RESTART_INDEX;
+    }
+    else {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+        mesh.indexType = GL_UNSIGNED_INT;
+        mesh.indexSize = sizeof(unsigned int);
+        mesh.restartIndex = restartIndex;
+    }
+}
+
+// Upload vertices and indices into a new VAO (positions at location 0, UVs at 1).
+// A 32-bit restartIndex in the input is rewritten to 0xFFFF for 16-bit buffers.
+inline GpuMesh uploadMesh(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount,
+                          unsigned int restartIndex = NO_RESTART_INDEX) {
+    GpuMesh mesh;
+    mesh.vertexCount = vertexCount;
+
+    glGenVertexArrays(1, &mesh.vao);
+    glGenBuffers(1, &mesh.vbo);
+    glGenBuffers(1, &mesh.ebo);
+    glBindVertexArray(mesh.vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertices, GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+    uploadMeshIndices(mesh, indices, indexCount, restartIndex);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);                     // Position
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(3 * sizeof(float)));   // Texture coords
+    glEnableVertexAttribArray(1);
+
+    // Unbind VBO and VAO (the VAO keeps the EBO binding)
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    return mesh;
+}
+
+inline GpuMesh uploadMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+                          unsigned int restartIndex = NO_RESTART_INDEX) {
+    return uploadMesh(vertices.data(), vertices.size(), indices.data(), indices.size(), restartIndex);
+}
+
+// Same as uploadMesh, but the vertices are packed to PackedVertex first.
+// error (optional) receives how far the packed data is from the input.
+inline GpuMesh uploadPackedMesh(const Vertex* vertices, size_t vertexCount, const unsigned int* indices,
+                                size_t indexCount, unsigned int restartIndex = NO_RESTART_INDEX,
+                                PackingError* error = nullptr) {
+    std::vector<PackedVertex> packed(vertexCount);
+    GpuMesh mesh;
+    mesh.vertexCount = vertexCount;
+    mesh.quantization = packVertices(vertices, vertexCount, packed.data());
+    if (error)
+        *error = measurePackingError(vertices, packed.data(), vertexCount, mesh.quantization);
+
+    glGenVertexArrays(1, &mesh.vao);
+    glGenBuffers(1, &mesh.vbo);
+    glGenBuffers(1, &mesh.ebo);
+    glBindVertexArray(mesh.vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(PackedVertex), packed.data(), GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+    uploadMeshIndices(mesh, indices, indexCount, restartIndex);
+
+    // Shorts converted to float as-is; the shader applies scale and offset
+    glVertexAttribPointer(0, 3, GL_SHORT, GL_FALSE, sizeof(PackedVertex), (void*)0);              // Position
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)(4 * sizeof(int16_t))); // Texture coords
+    glEnableVertexAttribArray(1);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    return mesh;
+}
+
+inline GpuMesh uploadPackedMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+                                unsigned int restartIndex = NO_RESTART_INDEX, PackingError* error = nullptr) {
+    return uploadPackedMesh(vertices.data(), vertices.size(), indices.data(), indices.size(), restartIndex, error);
+}
+
+// Attach one texture array layer per vertex (location 2, an integer attribute).
+// It is a separate stream, so it works with both Vertex and PackedVertex data.
+inline void uploadVertexLayers(GpuMesh& mesh, const uint8_t* layers, size_t vertexCount) {
+    glBindVertexArray(mesh.vao);
+    if (!mesh.layerVbo)
+        glGenBuffers(1, &mesh.layerVbo);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.layerVbo);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(uint8_t), layers, GL_STATIC_DRAW);
+    glVertexAttribIPointer(2, 1, GL_UNSIGNED_BYTE, sizeof(uint8_t), (void*)0);   // Layer
+    glEnableVertexAttribArray(2);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+inline void uploadVertexLayers(GpuMesh& mesh, const std::vector<uint8_t>& layers) {
+    uploadVertexLayers(mesh, layers.data(), layers.size());
+}
+
+// Per-instance data (locations 3-6: model matrix columns, 7: texture array layer).
+// Plain floats rather than Mat4, which would pad the stride to its 32-byte alignment.
+struct InstanceData {
+    float model[16];
+    uint32_t layer;
+};
+
+struct InstanceBuffer {
+    unsigned int vbo = 0;
+    size_t count = 0;
+};
+
+// Replace the buffer's contents (creating it on first use). Meshes bound with
+// bindInstances keep reading from it, so they need not be bound again.
+inline void uploadInstances(InstanceBuffer& buffer, const InstanceData* instances, size_t count) {
+    if (!buffer.vbo)
+        glGenBuffers(1, &buffer.vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer.vbo);
+    glBufferData(GL_ARRAY_BUFFER, count * sizeof(InstanceData), instances, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    buffer.count = count;
+}
+
+inline void uploadInstances(InstanceBuffer& buffer, const std::vector<InstanceData>& instances) {
+    uploadInstances(buffer, instances.data(), instances.size());
+}
+
+// Point the mesh's VAO at InstanceData stored at byte offset in vbo, advancing once
+// per instance (divisor 1). Streamed instances are rebound at each frame's offset.
+inline void bindInstances(const GpuMesh& mesh, unsigned int vbo, size_t offset) {
+    glBindVertexArray(mesh.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    for (GLuint column = 0; column < 4; ++column) {
+        glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                              (void*)(offset + column * 4 * sizeof(float)));                      // Model column
+        glEnableVertexAttribArray(3 + column);
+        glVertexAttribDivisor(3 + column, 1);
+    }
+    glVertexAttribIPointer(7, 1, GL_UNSIGNED_INT, sizeof(InstanceData),
+                           (void*)(offset + 16 * sizeof(float)));                                 // Layer
+    glEnableVertexAttribArray(7);
+    glVertexAttribDivisor(7, 1);
+
+    // Without uploadVertexLayers, location 2 reads the current value: make that layer 0
+    if (!mesh.layerVbo)
+        glVertexAttribI4ui(2, 0, 0, 0, 0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+inline void bindInstances(const GpuMesh& mesh, const InstanceBuffer& buffer) {
+    bindInstances(mesh, buffer.vbo, 0);
+}
+
+inline void deleteInstances(InstanceBuffer& buffer) {
+    glDeleteBuffers(1, &buffer.vbo);
+    buffer = InstanceBuffer();
+}
+
+// Set the vertex shader's dequantization uniforms for this mesh (identity for unpacked
+// meshes). program must be in use; unchanged values are not uploaded again.
+inline void setPositionQuantization(ShaderProgram& program, const GpuMesh& mesh) {
+    program.setVec3("positionScale", mesh.quantization.scale);
+    program.setVec3("positionOffset", mesh.quantization.offset);
+}
+
+// Draw count indices starting at index firstIndex; the VAO must already be bound
+inline void drawMeshRange(const GpuMesh& mesh, GLenum mode, size_t firstIndex, size_t count) {
+    glDrawElements(mode, (GLsizei)count, mesh.indexType, (void*)(firstIndex * mesh.indexSize));
+}
+
+// Bind the VAO and draw every index
+inline void drawMesh(const GpuMesh& mesh, GLenum mode) {
+    glBindVertexArray(mesh.vao);
+    drawMeshRange(mesh, mode, 0, mesh.indexCount);
+}
+
+// Bind the VAO and draw every index once per instance (bindInstances first)
+inline void drawMeshInstanced(const GpuMesh& mesh, GLenum mode, size_t instanceCount) {
+    glBindVertexArray(mesh.vao);
+    glDrawElementsInstanced(mode, (GLsizei)mesh.indexCount, mesh.indexType, (void*)0, (GLsizei)instanceCount);
+}
+
+// Bind the VAO and draw count indices from firstIndex once per instance, adding baseVertex
+// to every index (a level of a MeshLod chain sharing the mesh's buffers)
+inline void drawMeshInstancedRange(const GpuMesh& mesh, GLenum mode, size_t firstIndex, size_t count,
+                                   size_t baseVertex, size_t instanceCount) {
+    glBindVertexArray(mesh.vao);
+    glDrawElementsInstancedBaseVertex(mode, (GLsizei)count, mesh.indexType, (void*)(firstIndex * mesh.indexSize),
+                                      (GLsizei)instanceCount, (GLint)baseVertex);
+}
+
+inline void deleteMesh(GpuMesh& mesh) {
+    glDeleteVertexArrays(1, &mesh.vao);
+    glDeleteBuffers(1, &mesh.vbo);
+    glDeleteBuffers(1, &mesh.ebo);
+    glDeleteBuffers(1, &mesh.layerVbo);
+    mesh = GpuMesh();
+}
+
+inline void printGpuMesh(const char* label, const GpuMesh& mesh) {
+    printf("%s: %zu vertices, %zu %d-bit indices (%zu bytes, %zu with 32-bit)\n", label, mesh.vertexCount,
+           mesh.indexCount, (int)mesh.indexSize * 8, mesh.indexCount * mesh.indexSize,
+           mesh.indexCount * sizeof(unsigned int));
+}
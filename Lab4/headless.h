@@ -0,0 +1,167 @@
+#pragma once
+
+// Headless rendering for the Lab4 demos (--headless N).
+//
+// HeadlessContext replaces the GLFW window on machines without a display: it
+// creates a GL 3.3 core context through EGL (Mesa's surfaceless platform when
+// available, so llvmpipe works on a bare server), loads glad from it and
+// renders into an offscreen framebuffer of the window's size, left bound for
+// the whole run. endFrame stands in for glfwSwapBuffers; after the last frame
+// writePng dumps the color buffer for golden-image comparison (png_writer.h).
+//
+// Builds without EGL headers compile the class, but create() fails. Like
+// ShaderProgram, the destructor makes no GL calls; call destroy() at exit.
+
+#include <glad/glad.h>
+#include "png_writer.h"
+
+#if __has_include(<EGL/egl.h>)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#define HEADLESS_HAS_EGL 1
+#endif
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+class HeadlessContext {
+public:
+    HeadlessContext() = default;
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    // Make a context current and bind a width x height color + depth framebuffer; errors go to stderr
+    bool create(int width, int height) {
+#ifdef HEADLESS_HAS_EGL
+        this->width = width;
+        this->height = height;
+
+        // The surfaceless platform needs no display server; otherwise whatever EGL picks by default
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+        const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        if (clientExtensions && strstr(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+            auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+            if (getPlatformDisplay)
+                display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        }
+#endif
+        if (display == EGL_NO_DISPLAY)
+            display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr))
+            return fail("no EGL display");
+
+        const EGLint configAttributes[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                            EGL_NONE };
+        EGLConfig config;
+        EGLint configCount = 0;
+        if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0)
+            return fail("no EGL config for desktop OpenGL");
+        if (!eglBindAPI(EGL_OPENGL_API))
+            return fail("desktop OpenGL not supported by EGL");
+
+        const EGLint contextAttributes[] = { EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+                                             EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                             EGL_NONE };
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+        if (context == EGL_NO_CONTEXT)
+            return fail("could not create an OpenGL 3.3 core context");
+
+        // Nothing is drawn to the EGL surface; without surfaceless contexts a 1x1 pbuffer satisfies eglMakeCurrent
+        const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+        if (!extensions || !strstr(extensions, "EGL_KHR_surfaceless_context")) {
+            const EGLint pbufferAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+            surface = eglCreatePbufferSurface(display, config, pbufferAttributes);
+            if (surface == EGL_NO_SURFACE)
+                return fail("could not create a pbuffer");
+        }
+        if (!eglMakeCurrent(display, surface, surface, context))
+            return fail("eglMakeCurrent failed");
+        if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+            return fail("failed to initialize GLAD");
+
+        glGenRenderbuffers(2, renderbuffers);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            return fail("offscreen framebuffer incomplete");
+
+        std::cout << "Headless: " << width << "x" << height << " offscreen framebuffer, "
+                  << glGetString(GL_RENDERER) << std::endl;
+        return true;
+#else
+        (void)width;
+        (void)height;
+        return fail("built without EGL headers");
+#endif
+    }
+
+    // End of a frame: submit its commands as a buffer swap would
+    void endFrame() { glFlush(); }
+
+    // Save the framebuffer's color as PNG, top row first
+    bool writePng(const char* path) const {
+        std::vector<uint8_t> pixels((size_t)width * height * 4);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+        // GL rows run bottom to top
+        size_t rowBytes = (size_t)width * 4;
+        std::vector<uint8_t> row(rowBytes);
+        for (int y = 0; y < height / 2; ++y) {
+            uint8_t* top = pixels.data() + y * rowBytes;
+            uint8_t* bottom = pixels.data() + (height - 1 - y) * rowBytes;
+            memcpy(row.data(), top, rowBytes);
+            memcpy(top, bottom, rowBytes);
+            memcpy(bottom, row.data(), rowBytes);
+        }
+        return ::writePng(path, width, height, pixels.data());
+    }
+
+    void destroy() {
+#ifdef HEADLESS_HAS_EGL
+        if (context != EGL_NO_CONTEXT) {
+            if (framebuffer)
+                glDeleteFramebuffers(1, &framebuffer);
+            if (renderbuffers[0])
+                glDeleteRenderbuffers(2, renderbuffers);
+            eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            eglDestroyContext(display, context);
+        }
+        if (surface != EGL_NO_SURFACE)
+            eglDestroySurface(display, surface);
+        if (display != EGL_NO_DISPLAY)
+            eglTerminate(display);
+        display = EGL_NO_DISPLAY;
+        context = EGL_NO_CONTEXT;
+        surface = EGL_NO_SURFACE;
+#endif
+        framebuffer = 0;
+        renderbuffers[0] = renderbuffers[1] = 0;
+    }
+
+private:
+    bool fail(const char* reason) {
+        std::cerr << "Failed to create headless context: " << reason << std::endl;
+        destroy();
+        return false;
+    }
+
+#ifdef HEADLESS_HAS_EGL
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+    EGLSurface surface = EGL_NO_SURFACE;
+#endif
+    unsigned int framebuffer = 0;
+    unsigned int renderbuffers[2] = {};
+    int width = 0, height = 0;
+};
@@ -0,0 +1,408 @@
+#pragma once
+
+// Instanced scenes for the Lab4 demos (--instances N, --instance-sweep).
+//
+// generateInstanceScene scatters N copies of the demo's mesh over a cubic
+// grid, each with its own rotation, scale and texture array layer. The model
+// matrices and layers go into an InstanceBuffer (gl_mesh.h) and the whole
+// scene is drawn with one glDrawElementsInstanced call, so the CPU cost of a
+// frame stays the same from one instance to 100k. With --animate, the
+// instances spin and InstanceStreamer rewrites their matrices every frame
+// through a StreamRing (stream_ring.h). With --cull, InstanceCuller keeps a
+// BVH (culling.h) over the instances and only the ones in view are streamed.
+// With --lod, InstanceLodGroups sorts them by level of detail (lod.h) and each
+// level is drawn with one instanced call.
+
+#include <glad/glad.h>
+#include "culling.h"
+#include "gl_mesh.h"
+#include "lod.h"
+#include "math3d.h"
+#include "stream_ring.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Shared by all three demos: model matrix and layer per instance, plus the
+// per-vertex layer of meshes with uploadVertexLayers (0 otherwise).
+const char* const instancedVertexShaderSource = R"glsl(
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+layout (location = 2) in uint aLayer;
+layout (location = 3) in mat4 aModel;
+layout (location = 7) in uint aInstanceLayer;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform int layerCount;
+
+// Position dequantization (identity for float vertices)
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
+out vec2 TexCoord;
+flat out uint Layer;
+
+void main()
+{
+    vec3 position = aPos * positionScale + positionOffset;
+    gl_Position = projection * view * aModel * vec4(position, 1.0);
+    TexCoord = aTexCoord;
+    Layer = (aLayer + aInstanceLayer) % uint(layerCount);
+}
+)glsl";
+
+const char* const instancedFragmentShaderSource = R"glsl(
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+flat in uint Layer;
+
+uniform sampler2DArray textureArray;
+
+void main()
+{
+    FragColor = texture(textureArray, vec3(TexCoord, float(Layer)));
+}
+)glsl";
+
+// Instance counts timed by --instance-sweep
+const size_t INSTANCE_SWEEP_COUNTS[] = { 1, 10, 100, 1000, 10000, 100000 };
+
+// Cells per edge of the smallest cube with room for count instances
+inline size_t instanceGridSide(size_t count) {
+    size_t side = 1;
+    while (side * side * side < count)
+        ++side;
+    return side;
+}
+
+// count instances on a cubic grid centered at the origin, spacing apart, each
+// with a random Y rotation, a scale in [0.5, 1] and a layer below layerCount.
+// The same count and seed always give the same scene.
+inline std::vector<InstanceData> generateInstanceScene(size_t count, unsigned int layerCount, float spacing = 2.0f,
+                                                       uint32_t seed = 1) {
+    std::vector<InstanceData> instances(count);
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    size_t side = instanceGridSide(count);
+    float half = (side - 1) * spacing * 0.5f;
+
+    for (size_t i = 0; i < count; ++i) {
+        float angle = unit(random) * 6.28318530718f;
+        float scale = 0.5f + 0.5f * unit(random);
+        float cosA = cosf(angle) * scale, sinA = sinf(angle) * scale;
+
+        // Rotation about Y (as setRotationYMatrix), scaled, then translated to the cell
+        float* m = instances[i].model;
+        memset(m, 0, 16 * sizeof(float));
+        m[0] = cosA;
+        m[2] = sinA;
+        m[5] = scale;
+        m[8] = -sinA;
+        m[10] = cosA;
+        m[12] = (i % side) * spacing - half;
+        m[13] = (i / side % side) * spacing - half;
+        m[14] = (i / (side * side)) * spacing - half;
+        m[15] = 1.0f;
+        instances[i].layer = (uint32_t)(random() % layerCount);
+    }
+    return instances;
+}
+
+// View and projection that frame the whole scene from a diagonal
+inline void setInstanceSceneCamera(Mat4& view, Mat4& projection, size_t count, float aspect, float spacing = 2.0f) {
+    float radius = (instanceGridSide(count) - 1) * spacing * 0.5f * 1.7320508f + spacing;
+    float distance = radius / sinf(22.5f * 3.14159265f / 180.0f);   // Fits a 45 degree field of view
+    float eye = distance / sqrtf(2.5625f);                            // Eye along (1, 0.75, 1)
+    setLookAtMatrix(view, eye, eye * 0.75f, eye, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+    setPerspectiveMatrix(projection, 45.0f, aspect, std::max(0.1f, (distance - radius) * 0.5f), distance + radius);
+}
+
+// View from the middle of the scene along the same diagonal, so most instances are behind or beside the camera
+inline void setInstanceSceneInteriorCamera(Mat4& view, Mat4& projection, size_t count, float aspect,
+                                           float spacing = 2.0f) {
+    float radius = (instanceGridSide(count) - 1) * spacing * 0.5f * 1.7320508f + spacing;
+    setLookAtMatrix(view, 0.0f, 0.0f, 0.0f, 1.0f, 0.75f, 1.0f, 0.0f, 1.0f, 0.0f);
+    setPerspectiveMatrix(projection, 45.0f, aspect, 0.1f, 2.0f * radius);
+}
+
+// Time drawFrame() for each of INSTANCE_SWEEP_COUNTS: the scene is generated
+// and uploaded into instances, view and projection are set to frame it, then
+// frames are finished with glFinish until half a second (1 to 100 frames) has passed.
+template <typename DrawFrame>
+inline void runInstanceSweep(const char* label, InstanceBuffer& instances, unsigned int layerCount, float aspect,
+                             Mat4& view, Mat4& projection, DrawFrame drawFrame) {
+    using Clock = std::chrono::steady_clock;
+    printf("%s instance sweep (one glDrawElementsInstanced per mesh):\n", label);
+    printf("  %9s %12s %16s\n", "instances", "ms/frame", "instances/ms");
+    for (size_t count : INSTANCE_SWEEP_COUNTS) {
+        uploadInstances(instances, generateInstanceScene(count, layerCount));
+        setInstanceSceneCamera(view, projection, count, aspect);
+        drawFrame();   // Warm up: first use of the buffer and any lazy driver work
+        glFinish();
+
+        int frames = 0;
+        double elapsed = 0.0;
+        auto start = Clock::now();
+        while (frames == 0 || (elapsed < 0.5 && frames < 100)) {
+            drawFrame();
+            glFinish();
+            ++frames;
+            elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        }
+        double msPerFrame = 1000.0 * elapsed / frames;
+        printf("  %9zu %12.3f %16.1f\n", count, msPerFrame, count / msPerFrame);
+    }
+}
+
+// Spin instance index about its own Y axis at one of seven rates: out = instance * rotationY
+inline void animateInstance(const InstanceData& instance, size_t index, float seconds, InstanceData& out) {
+    float angle = seconds * (0.5f + 0.25f * (index % 7));
+    float cosA = cosf(angle), sinA = sinf(angle);
+    const float* m = instance.model;
+    float* o = out.model;
+    for (int row = 0; row < 4; ++row) {
+        o[row] = cosA * m[row] + sinA * m[8 + row];
+        o[4 + row] = m[4 + row];
+        o[8 + row] = cosA * m[8 + row] - sinA * m[row];
+        o[12 + row] = m[12 + row];
+    }
+    out.layer = instance.layer;
+}
+
+inline void animateInstances(const InstanceData* scene, size_t count, float seconds, InstanceData* out) {
+    for (size_t i = 0; i < count; ++i)
+        animateInstance(scene[i], i, seconds, out[i]);
+}
+
+// Only the instances listed in subset, packed into out
+inline void animateInstances(const InstanceData* scene, const std::vector<uint32_t>& subset, float seconds,
+                             InstanceData* out) {
+    for (size_t i = 0; i < subset.size(); ++i)
+        animateInstance(scene[subset[i]], subset[i], seconds, out[i]);
+}
+
+// Largest scale factor of an instance's model matrix (its longest basis column)
+inline float instanceScale(const InstanceData& instance) {
+    const float* m = instance.model;
+    return sqrtf(std::max({ m[0] * m[0] + m[1] * m[1] + m[2] * m[2],
+                            m[4] * m[4] + m[5] * m[5] + m[6] * m[6],
+                            m[8] * m[8] + m[9] * m[9] + m[10] * m[10] }));
+}
+
+// Frustum culling for an instance scene: a BVH over bounds that contain each
+// instance however it spins, so it is built once even with --animate
+class InstanceCuller {
+public:
+    // meshRadius: computeBoundingRadius of the mesh's vertices
+    void create(const std::vector<InstanceData>& scene, float meshRadius) {
+        std::vector<Aabb> bounds(scene.size());
+        for (size_t i = 0; i < scene.size(); ++i) {
+            const float* m = scene[i].model;
+            float radius = meshRadius * instanceScale(scene[i]);
+            bounds[i] = { { m[12], m[13], m[14] }, { radius, radius, radius } };
+        }
+        bvh.build(bounds.data(), bounds.size());
+        total = scene.size();
+    }
+
+    // Instances that may be visible with this camera
+    const std::vector<uint32_t>& cull(const Mat4& view, const Mat4& projection) {
+        auto start = std::chrono::steady_clock::now();
+        Mat4 viewProjection;
+        multiplyMatrices(view, projection, viewProjection);
+        bvh.cull(extractFrustum(viewProjection), visibleInstances);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        cullMs += elapsed.count();
+        visibleSum += visibleInstances.size();
+        minVisible = std::min(minVisible, visibleInstances.size());
+        maxVisible = std::max(maxVisible, visibleInstances.size());
+        ++frames;
+        return visibleInstances;
+    }
+
+    const std::vector<uint32_t>& visible() const { return visibleInstances; }
+
+    void printReport(const char* label) const {
+        if (frames == 0)
+            return;
+        double visibleMean = (double)visibleSum / frames;
+        printf("%s: %zu instances, %zu BVH nodes; per frame %.0f visible (%zu to %zu), %.0f culled, %.3f ms to cull\n",
+               label, total, bvh.nodeCount(), visibleMean, minVisible, maxVisible, total - visibleMean, cullMs / frames);
+    }
+
+private:
+    Bvh bvh;
+    std::vector<uint32_t> visibleInstances;
+    size_t total = 0;
+    size_t frames = 0;
+    size_t visibleSum = 0;
+    size_t minVisible = SIZE_MAX, maxVisible = 0;
+    double cullMs = 0.0;
+};
+
+// Instances grouped by level of detail: order() lists them level by level
+// (finest first), ready to be streamed as a subset, and level l covers
+// levelSize(l) entries from levelStart(l). Spinning does not move an
+// instance or change its scale, so --animate needs no extra work.
+class InstanceLodGroups {
+public:
+    void create(const std::vector<InstanceData>& scene, std::vector<MeshLod> chain, float maxPixelError) {
+        centers.resize(scene.size());
+        scales.resize(scene.size());
+        for (size_t i = 0; i < scene.size(); ++i) {
+            centers[i] = { scene[i].model[12], scene[i].model[13], scene[i].model[14], 0.0f };
+            scales[i] = instanceScale(scene[i]);
+        }
+        size_t levelCount = chain.size();
+        selector.create(std::move(chain), scene.size(), maxPixelError);
+        starts.assign(levelCount + 1, 0);
+    }
+
+    // Pick each instance's level (of all instances, or of subset) and group them
+    const std::vector<uint32_t>& select(const Mat4& view, const Mat4& projection, int viewportHeight,
+                                        const std::vector<uint32_t>* subset = nullptr) {
+        auto start = std::chrono::steady_clock::now();
+        size_t count = subset ? subset->size() : centers.size();
+        levels.resize(count);
+        std::fill(starts.begin(), starts.end(), 0);
+        selector.beginFrame(projection, viewportHeight);
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t instance = subset ? (*subset)[i] : (uint32_t)i;
+            const Vec4& c = centers[instance];
+            levels[i] = (uint8_t)selector.select(instance, viewDepth(view, c.x, c.y, c.z), scales[instance]);
+            ++starts[levels[i] + 1];
+        }
+        selector.endFrame();
+
+        // Counting sort by level
+        for (size_t level = 1; level < starts.size(); ++level)
+            starts[level] += starts[level - 1];
+        ordered.resize(count);
+        std::vector<size_t> next(starts.begin(), starts.end() - 1);
+        for (size_t i = 0; i < count; ++i)
+            ordered[next[levels[i]]++] = subset ? (*subset)[i] : (uint32_t)i;
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        selectMs += elapsed.count();
+        ++frames;
+        return ordered;
+    }
+
+    const std::vector<uint32_t>& order() const { return ordered; }
+    size_t levelStart(size_t level) const { return starts[level]; }
+    size_t levelSize(size_t level) const { return starts[level + 1] - starts[level]; }
+    const std::vector<MeshLod>& chain() const { return selector.chain(); }
+
+    void printReport(const char* label) const {
+        selector.printReport(label);
+        if (frames)
+            printf("  %.3f ms per frame to select and group\n", selectMs / frames);
+    }
+
+private:
+    LodSelector selector;
+    std::vector<Vec4> centers;
+    std::vector<float> scales;
+    std::vector<uint8_t> levels;    // Per listed instance, this frame
+    std::vector<uint32_t> ordered;
+    std::vector<size_t> starts;     // Level l is ordered[starts[l], starts[l + 1])
+    double selectMs = 0.0;
+    size_t frames = 0;
+};
+
+// Animated instances sent to the GPU every frame: posed straight into a
+// StreamRing segment or, for comparison, posed into memory and re-uploaded
+// with glBufferData. Call update before the frame's draws and endFrame after.
+// Given a subset (InstanceCuller::cull), only those instances are sent and
+// count() drops to its size; bindRange points a mesh at part of them.
+class InstanceStreamer {
+public:
+    void create(std::vector<InstanceData> restPose, bool useRing) {
+        scene = std::move(restPose);
+        ringEnabled = useRing;
+        if (ringEnabled)
+            ring.create(scene.size() * sizeof(InstanceData));
+        else
+            posed.resize(scene.size());
+    }
+
+    // Pose the scene (or its subset) at seconds, upload it and point the meshes' instance attributes at it
+    void update(float seconds, const GpuMesh* meshes, size_t meshCount, const std::vector<uint32_t>* subset = nullptr) {
+        auto start = std::chrono::steady_clock::now();
+        posedCount = subset ? subset->size() : scene.size();
+        if (ringEnabled) {
+            ring.beginFrame();
+            size_t offset = 0;
+            void* target = ring.map(posedCount * sizeof(InstanceData), offset);
+            posedOffset = offset;
+            if (target) {
+                if (subset)
+                    animateInstances(scene.data(), *subset, seconds, static_cast<InstanceData*>(target));
+                else
+                    animateInstances(scene.data(), scene.size(), seconds, static_cast<InstanceData*>(target));
+                ring.unmap();
+            }
+            for (size_t i = 0; i < meshCount; ++i)
+                bindInstances(meshes[i], ring.buffer(), offset);
+        }
+        else {
+            if (subset)
+                animateInstances(scene.data(), *subset, seconds, posed.data());
+            else
+                animateInstances(scene.data(), scene.size(), seconds, posed.data());
+            uploadInstances(buffer, posed.data(), posedCount);
+            for (size_t i = 0; i < meshCount; ++i)
+                bindInstances(meshes[i], buffer);
+        }
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        updateMs += elapsed.count();
+        ++frames;
+    }
+
+    void endFrame() {
+        if (ringEnabled)
+            ring.endFrame();
+    }
+
+    // Instances sent by the last update
+    size_t count() const { return posedCount; }
+
+    // Point the mesh's instance attributes at the last update's instances from first on
+    void bindRange(const GpuMesh& mesh, size_t first) const {
+        bindInstances(mesh, ringEnabled ? ring.buffer() : buffer.vbo, posedOffset + first * sizeof(InstanceData));
+    }
+
+    void destroy() {
+        ring.destroy();
+        deleteInstances(buffer);
+    }
+
+    void printReport(const char* label) const {
+        printf("%s: %zu instances (%.1f KiB) per frame through %s, %.3f ms CPU per frame to pose and upload\n",
+               label, posedCount, posedCount * sizeof(InstanceData) / 1024.0,
+               ringEnabled ? "the stream ring" : "glBufferData", frames ? updateMs / frames : 0.0);
+        if (ringEnabled)
+            ring.printReport("Stream ring");
+    }
+
+private:
+    std::vector<InstanceData> scene, posed;
+    bool ringEnabled = false;
+    size_t posedCount = 0;
+    size_t posedOffset = 0;     // Byte offset of the last update's instances
+    StreamRing ring;
+    InstanceBuffer buffer;      // Only without the ring
+    double updateMs = 0.0;
+    size_t frames = 0;
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+// Discrete level of detail (--lod in the sphere demo, "lod" in bench.cpp).
+//
+// A mesh comes as a chain of MeshLod levels (mesh.h), finest first, each
+// with its geometric error in mesh units. An object is drawn with the
+// coarsest level whose error, projected to the screen at the object's depth,
+// stays under maxPixelError. Objects whose size on screen hovers around a
+// threshold would flip between two levels every few frames, so LodSelector
+// remembers each object's level: it refines as soon as the error exceeds
+// maxPixelError but only coarsens once the coarser level's error is below
+// (1 - hysteresis) * maxPixelError.
+
+#include "math3d.h"
+#include "mesh.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+// Pixels spanned by one world unit at view depth 1 (divide by the depth for others)
+inline float pixelsPerUnitAtUnitDepth(const Mat4& projection, int viewportHeight) {
+    return projection[5] * viewportHeight * 0.5f;
+}
+
+// Distance of a world position in front of the camera (-z in view space)
+inline float viewDepth(const Mat4& view, float x, float y, float z) {
+    return -(view[2] * x + view[6] * y + view[10] * z + view[14]);
+}
+
+inline void printLodChain(const char* label, const std::vector<MeshLod>& levels) {
+    printf("%s: %zu levels\n", label, levels.size());
+    for (size_t i = 0; i < levels.size(); ++i)
+        printf("  level %zu: %6zu triangles, %5zu vertices, error %.5f\n", i, levels[i].triangleCount,
+               levels[i].vertexCount, levels[i].error);
+}
+
+class LodSelector {
+public:
+    void create(std::vector<MeshLod> chain, size_t objectCount, float maxPixelError = 1.0f,
+                float hysteresis = 0.25f) {
+        levels = std::move(chain);
+        current.assign(objectCount, kUnselected);
+        this->maxPixelError = maxPixelError;
+        coarsenBelow = maxPixelError * (1.0f - hysteresis);
+        levelObjects.assign(levels.size(), 0);
+    }
+
+    // Start a frame seen through projection on a viewport viewportHeight pixels tall
+    void beginFrame(const Mat4& projection, int viewportHeight) {
+        pixelScale = pixelsPerUnitAtUnitDepth(projection, viewportHeight);
+    }
+
+    // Level for object at depth (viewDepth) this frame; scale converts mesh units to world units
+    unsigned int select(size_t object, float depth, float scale) {
+        float pixelsPerError = scale * pixelScale / std::max(depth, 1e-3f);   // Behind or at the eye: finest
+        unsigned int previous = current[object];
+        unsigned int level = previous == kUnselected ? (unsigned int)levels.size() - 1 : previous;
+        if (levels[level].error * pixelsPerError > maxPixelError) {
+            while (level > 0 && levels[level].error * pixelsPerError > maxPixelError)
+                --level;
+        }
+        else {
+            float threshold = previous == kUnselected ? maxPixelError : coarsenBelow;
+            while (level + 1 < levels.size() && levels[level + 1].error * pixelsPerError <= threshold)
+                ++level;
+        }
+        if (previous != kUnselected && level != previous)
+            ++switches;
+        current[object] = (uint8_t)level;
+        ++levelObjects[level];
+        trianglesDrawn += levels[level].triangleCount;
+        trianglesFull += levels[0].triangleCount;
+        return level;
+    }
+
+    void endFrame() { ++frames; }
+
+    const std::vector<MeshLod>& chain() const { return levels; }
+
+    void printReport(const char* label) const {
+        if (frames == 0)
+            return;
+        printf("%s: per frame %.0f of %.0f triangles (%.1f%% saved, %.2fx throughput), %.1f level switches\n", label,
+               (double)trianglesDrawn / frames, (double)trianglesFull / frames,
+               trianglesFull ? 100.0 * (trianglesFull - trianglesDrawn) / trianglesFull : 0.0,
+               trianglesDrawn ? (double)trianglesFull / trianglesDrawn : 0.0, (double)switches / frames);
+        printf("  objects per level:");
+        for (size_t objects : levelObjects)
+            printf(" %.0f", (double)objects / frames);
+        printf("\n");
+    }
+
+private:
+    static constexpr uint8_t kUnselected = 0xFF;
+
+    std::vector<MeshLod> levels;
+    std::vector<uint8_t> current;   // Level each object was drawn with last, kUnselected before its first frame
+    float maxPixelError = 1.0f;
+    float coarsenBelow = 0.75f;
+    float pixelScale = 1.0f;
+    size_t frames = 0;
+    size_t switches = 0;
+    size_t trianglesDrawn = 0, trianglesFull = 0;
+    std::vector<size_t> levelObjects;
+};
@@ -0,0 +1,254 @@
+#pragma once
+
+// 4x4 matrix and vector math shared by the Lab4 demos.
+//
+// Matrices are 16 floats in the same layout the demos have always used and
+// pass straight to glUniformMatrix4fv(..., GL_FALSE, m): m[0..3] is the first
+// column in GL terms. Kernels use AVX when compiled with -mavx, otherwise SSE
+// (always available on x86-64), with a scalar fallback for other targets.
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define MATH3D_AVX 1
+#define MATH3D_SSE 1
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MATH3D_SSE 1
+#endif
+
+// 16-byte aligned 4-component vector (point or direction)
+struct alignas(16) Vec4 {
+    float x, y, z, w;
+};
+
+// 32-byte aligned 4x4 matrix, so AVX can load row pairs
+struct alignas(32) Mat4 {
+    float m[16];
+
+    float& operator[](int i) { return m[i]; }
+    float operator[](int i) const { return m[i]; }
+};
+
+// Set a 4x4 identity matrix
+inline void setIdentityMatrix(Mat4& mat) {
+    memset(mat.m, 0, 16 * sizeof(float));
+    mat.m[0] = mat.m[5] = mat.m[10] = mat.m[15] = 1.0f;
+}
+
+// Multiply two 4x4 matrices: result = a * b (result may alias a or b)
+inline void multiplyMatrices(const Mat4& a, const Mat4& b, Mat4& result) {
+#if defined(MATH3D_AVX)
+    // Two rows of a per 256-bit register; each lane broadcasts its own row's elements
+    __m256 b0 = _mm256_broadcast_ps((const __m128*)&b.m[0]);
+    __m256 b1 = _mm256_broadcast_ps((const __m128*)&b.m[4]);
+    __m256 b2 = _mm256_broadcast_ps((const __m128*)&b.m[8]);
+    __m256 b3 = _mm256_broadcast_ps((const __m128*)&b.m[12]);
+    __m256 a01 = _mm256_load_ps(&a.m[0]);
+    __m256 a23 = _mm256_load_ps(&a.m[8]);
+
+    __m256 r01 = _mm256_mul_ps(_mm256_permute_ps(a01, 0x00), b0);
+    r01 = _mm256_add_ps(r01, _mm256_mul_ps(_mm256_permute_ps(a01, 0x55), b1));
+    r01 = _mm256_add_ps(r01, _mm256_mul_ps(_mm256_permute_ps(a01, 0xAA), b2));
+    r01 = _mm256_add_ps(r01, _mm256_mul_ps(_mm256_permute_ps(a01, 0xFF), b3));
+    __m256 r23 = _mm256_mul_ps(_mm256_permute_ps(a23, 0x00), b0);
+    r23 = _mm256_add_ps(r23, _mm256_mul_ps(_mm256_permute_ps(a23, 0x55), b1));
+    r23 = _mm256_add_ps(r23, _mm256_mul_ps(_mm256_permute_ps(a23, 0xAA), b2));
+    r23 = _mm256_add_ps(r23, _mm256_mul_ps(_mm256_permute_ps(a23, 0xFF), b3));
+
+    _mm256_store_ps(&result.m[0], r01);
+    _mm256_store_ps(&result.m[8], r23);
+#elif defined(MATH3D_SSE)
+    // Load b first so result can alias it; row i of result only reads row i of a
+    __m128 b0 = _mm_load_ps(&b.m[0]);
+    __m128 b1 = _mm_load_ps(&b.m[4]);
+    __m128 b2 = _mm_load_ps(&b.m[8]);
+    __m128 b3 = _mm_load_ps(&b.m[12]);
+    for (int i = 0; i < 4; i++) {
+        __m128 row = _mm_load_ps(&a.m[i * 4]);
+        __m128 r = _mm_mul_ps(_mm_shuffle_ps(row, row, 0x00), b0);
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(row, row, 0x55), b1));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(row, row, 0xAA), b2));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(row, row, 0xFF), b3));
+        _mm_store_ps(&result.m[i * 4], r);
+    }
+#else
+    float temp[16];
+    for (int i = 0; i < 4; i++) { // rows of a
+        for (int j = 0; j < 4; j++) { // columns of b
+            temp[i * 4 + j] = a.m[i * 4 + 0] * b.m[0 * 4 + j] +
+                              a.m[i * 4 + 1] * b.m[1 * 4 + j] +
+                              a.m[i * 4 + 2] * b.m[2 * 4 + j] +
+                              a.m[i * 4 + 3] * b.m[3 * 4 + j];
+        }
+    }
+    memcpy(result.m, temp, 16 * sizeof(float));
+#endif
+}
+
+// Batch multiply: result[i] = a[i] * b[i] for count matrices
+inline void multiplyMatrices(const Mat4* a, const Mat4* b, Mat4* result, size_t count) {
+    for (size_t i = 0; i < count; ++i)
+        multiplyMatrices(a[i], b[i], result[i]);
+}
+
+// Batch multiply by one matrix: result[i] = a[i] * b (e.g. model[i] * view)
+inline void multiplyMatrices(const Mat4* a, const Mat4& b, Mat4* result, size_t count) {
+    const Mat4 shared = b; // result may alias b
+    for (size_t i = 0; i < count; ++i)
+        multiplyMatrices(a[i], shared, result[i]);
+}
+
+// Transform one point the way the vertex shaders do: out = mat * p
+inline Vec4 transformPoint(const Mat4& mat, const Vec4& p) {
+    Vec4 out;
+#if defined(MATH3D_SSE)
+    __m128 v = _mm_load_ps(&p.x);
+    __m128 r = _mm_mul_ps(_mm_load_ps(&mat.m[0]), _mm_shuffle_ps(v, v, 0x00));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(&mat.m[4]), _mm_shuffle_ps(v, v, 0x55)));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(&mat.m[8]), _mm_shuffle_ps(v, v, 0xAA)));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(&mat.m[12]), _mm_shuffle_ps(v, v, 0xFF)));
+    _mm_store_ps(&out.x, r);
+#else
+    out.x = mat.m[0] * p.x + mat.m[4] * p.y + mat.m[8] * p.z + mat.m[12] * p.w;
+    out.y = mat.m[1] * p.x + mat.m[5] * p.y + mat.m[9] * p.z + mat.m[13] * p.w;
+    out.z = mat.m[2] * p.x + mat.m[6] * p.y + mat.m[10] * p.z + mat.m[14] * p.w;
+    out.w = mat.m[3] * p.x + mat.m[7] * p.y + mat.m[11] * p.z + mat.m[15] * p.w;
+#endif
+    return out;
+}
+
+// Batch transform: out[i] = mat * points[i] for count points
+inline void transformPoints(const Mat4& mat, const Vec4* points, Vec4* out, size_t count) {
+    size_t i = 0;
+#if defined(MATH3D_AVX)
+    // Two points per iteration, one per 128-bit lane
+    __m256 c0 = _mm256_broadcast_ps((const __m128*)&mat.m[0]);
+    __m256 c1 = _mm256_broadcast_ps((const __m128*)&mat.m[4]);
+    __m256 c2 = _mm256_broadcast_ps((const __m128*)&mat.m[8]);
+    __m256 c3 = _mm256_broadcast_ps((const __m128*)&mat.m[12]);
+    for (; i + 2 <= count; i += 2) {
+        __m256 v = _mm256_loadu_ps(&points[i].x);
+        __m256 r = _mm256_mul_ps(c0, _mm256_permute_ps(v, 0x00));
+        r = _mm256_add_ps(r, _mm256_mul_ps(c1, _mm256_permute_ps(v, 0x55)));
+        r = _mm256_add_ps(r, _mm256_mul_ps(c2, _mm256_permute_ps(v, 0xAA)));
+        r = _mm256_add_ps(r, _mm256_mul_ps(c3, _mm256_permute_ps(v, 0xFF)));
+        _mm256_storeu_ps(&out[i].x, r);
+    }
+#endif
+    for (; i < count; ++i)
+        out[i] = transformPoint(mat, points[i]);
+}
+
+// Batch transform of xyz positions (w = 1) read with a byte stride, e.g. from a Vertex array
+inline void transformPositions(const Mat4& mat, const void* positions, size_t stride, Vec4* out, size_t count) {
+    const unsigned char* src = (const unsigned char*)positions;
+#if defined(MATH3D_SSE)
+    __m128 c0 = _mm_load_ps(&mat.m[0]);
+    __m128 c1 = _mm_load_ps(&mat.m[4]);
+    __m128 c2 = _mm_load_ps(&mat.m[8]);
+    __m128 c3 = _mm_load_ps(&mat.m[12]);
+    for (size_t i = 0; i < count; ++i, src += stride) {
+        const float* p = (const float*)src;
+        __m128 r = _mm_add_ps(c3, _mm_mul_ps(c0, _mm_set1_ps(p[0])));
+        r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(p[1])));
+        r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(p[2])));
+        _mm_store_ps(&out[i].x, r);
+    }
+#else
+    for (size_t i = 0; i < count; ++i, src += stride) {
+        const float* p = (const float*)src;
+        Vec4 point = { p[0], p[1], p[2], 1.0f };
+        out[i] = transformPoint(mat, point);
+    }
+#endif
+}
+
+// Create a perspective projection matrix
+inline void setPerspectiveMatrix(Mat4& mat, float fov, float aspect, float nearPlane, float farPlane) {
+    float f = 1.0f / tanf(fov * 0.5f * (3.14159265358979323846f / 180.0f));
+    memset(mat.m, 0, 16 * sizeof(float));
+    mat.m[0] = f / aspect;
+    mat.m[5] = f;
+    mat.m[10] = (farPlane + nearPlane) / (nearPlane - farPlane);
+    mat.m[11] = -1.0f;
+    mat.m[14] = (2.0f * farPlane * nearPlane) / (nearPlane - farPlane);
+}
+
+// Create a lookAt view matrix
+inline void setLookAtMatrix(Mat4& mat, float eyeX, float eyeY, float eyeZ,
+                                       float centerX, float centerY, float centerZ,
+                                       float upX, float upY, float upZ) {
+    float forward[3], side[3], up[3];
+    float fwdLen, sideLen, upLen;
+
+    // Compute forward vector (center - eye)
+    forward[0] = centerX - eyeX;
+    forward[1] = centerY - eyeY;
+    forward[2] = centerZ - eyeZ;
+    fwdLen = sqrtf(forward[0]*forward[0] + forward[1]*forward[1] + forward[2]*forward[2]);
+
+    // Normalize forward vector
+    forward[0] /= fwdLen;
+    forward[1] /= fwdLen;
+    forward[2] /= fwdLen;
+
+    // Compute side vector = forward x up
+    side[0] = forward[1]*upZ - forward[2]*upY;
+    side[1] = forward[2]*upX - forward[0]*upZ;
+    side[2] = forward[0]*upY - forward[1]*upX;
+    sideLen = sqrtf(side[0]*side[0] + side[1]*side[1] + side[2]*side[2]);
+
+    // Normalize side vector
+    side[0] /= sideLen;
+    side[1] /= sideLen;
+    side[2] /= sideLen;
+
+    // Recompute up vector = side x forward
+    up[0] = side[1]*forward[2] - side[2]*forward[1];
+    up[1] = side[2]*forward[0] - side[0]*forward[2];
+    up[2] = side[0]*forward[1] - side[1]*forward[0];
+    upLen = sqrtf(up[0]*up[0] + up[1]*up[1] + up[2]*up[2]);
+
+    // Normalize up vector
+    up[0] /= upLen;
+    up[1] /= upLen;
+    up[2] /= upLen;
+
+    // Set the view matrix
+    mat.m[0] = side[0];
+    mat.m[1] = up[0];
+    mat.m[2] = -forward[0];
+    mat.m[3] = 0.0f;
+
+    mat.m[4] = side[1];
+    mat.m[5] = up[1];
+    mat.m[6] = -forward[1];
+    mat.m[7] = 0.0f;
+
+    mat.m[8] = side[2];
+    mat.m[9] = up[2];
+    mat.m[10] = -forward[2];
+    mat.m[11] = 0.0f;
+
+    mat.m[12] = - (side[0]*eyeX + side[1]*eyeY + side[2]*eyeZ);
+    mat.m[13] = - (up[0]*eyeX + up[1]*eyeY + up[2]*eyeZ);
+    mat.m[14] = forward[0]*eyeX + forward[1]*eyeY + forward[2]*eyeZ;
+    mat.m[15] = 1.0f;
+}
+
+// Create a rotation matrix around the Y axis
+inline void setRotationYMatrix(Mat4& mat, float angleDegrees) {
+    float radians = angleDegrees * (3.14159265358979323846f / 180.0f);
+    float cosA = cosf(radians);
+    float sinA = sinf(radians);
+
+    setIdentityMatrix(mat);
+    mat.m[0] = cosA;
+    mat.m[2] = sinA;
+    mat.m[8] = -sinA;
+    mat.m[10] = cosA;
+}
@@ -0,0 +1,580 @@
+#pragma once
+
+// Mesh generators shared by the Lab4 demos and tools
+
+#include "thread_pool.h"
+#include "vertex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Function to create the vertices of a box with texture coordinates (also usable at compile time)
+constexpr void createBoxVertices(Vertex* vertices, const Vertex& center, float width, float height, float depth) {
+    float halfWidth = width / 2.0f;
+    float halfHeight = height / 2.0f;
+    float halfDepth = depth / 2.0f;
+
+    // Define texture coordinates
+    float uvs[4][2] = {
+        {0.0f, 0.0f}, // Bottom-left
+        {1.0f, 0.0f}, // Bottom-right
+        {1.0f, 1.0f}, // Top-right
+        {0.0f, 1.0f}  // Top-left
+    };
+
+    // Front face
+    vertices[0] = {center.x - halfWidth, center.y - halfHeight, center.z + halfDepth, uvs[0][0], uvs[0][1]};
+    vertices[1] = {center.x + halfWidth, center.y - halfHeight, center.z + halfDepth, uvs[1][0], uvs[1][1]};
+    vertices[2] = {center.x + halfWidth, center.y + halfHeight, center.z + halfDepth, uvs[2][0], uvs[2][1]};
+    vertices[3] = {center.x - halfWidth, center.y + halfHeight, center.z + halfDepth, uvs[3][0], uvs[3][1]};
+
+    // Back face
+    vertices[4] = {center.x + halfWidth, center.y - halfHeight, center.z - halfDepth, uvs[0][0], uvs[0][1]};
+    vertices[5] = {center.x - halfWidth, center.y - halfHeight, center.z - halfDepth, uvs[1][0], uvs[1][1]};
+    vertices[6] = {center.x - halfWidth, center.y + halfHeight, center.z - halfDepth, uvs[2][0], uvs[2][1]};
+    vertices[7] = {center.x + halfWidth, center.y + halfHeight, center.z - halfDepth, uvs[3][0], uvs[3][1]};
+
+    // Left face
+    vertices[8]  = {center.x - halfWidth, center.y - halfHeight, center.z - halfDepth, uvs[0][0], uvs[0][1]};
+    vertices[9]  = {center.x - halfWidth, center.y - halfHeight, center.z + halfDepth, uvs[1][0], uvs[1][1]};
+    vertices[10] = {center.x - halfWidth, center.y + halfHeight, center.z + halfDepth, uvs[2][0], uvs[2][1]};
+    vertices[11] = {center.x - halfWidth, center.y + halfHeight, center.z - halfDepth, uvs[3][0], uvs[3][1]};
+
+    // Right face
+    vertices[12] = {center.x + halfWidth, center.y - halfHeight, center.z + halfDepth, uvs[0][0], uvs[0][1]};
+    vertices[13] = {center.x + halfWidth, center.y - halfHeight, center.z - halfDepth, uvs[1][0], uvs[1][1]};
+    vertices[14] = {center.x + halfWidth, center.y + halfHeight, center.z - halfDepth, uvs[2][0], uvs[2][1]};
+    vertices[15] = {center.x + halfWidth, center.y + halfHeight, center.z + halfDepth, uvs[3][0], uvs[3][1]};
+
+    // Top face
+    vertices[16] = {center.x - halfWidth, center.y + halfHeight, center.z + halfDepth, uvs[0][0], uvs[0][1]};
+    vertices[17] = {center.x + halfWidth, center.y + halfHeight, center.z + halfDepth, uvs[1][0], uvs[1][1]};
+    vertices[18] = {center.x + halfWidth, center.y + halfHeight, center.z - halfDepth, uvs[2][0], uvs[2][1]};
+    vertices[19] = {center.x - halfWidth, center.y + halfHeight, center.z - halfDepth, uvs[3][0], uvs[3][1]};
+
+    // Bottom face
+    vertices[20] = {center.x - halfWidth, center.y - halfHeight, center.z - halfDepth, uvs[0][0], uvs[0][1]};
+    vertices[21] = {center.x + halfWidth, center.y - halfHeight, center.z - halfDepth, uvs[1][0], uvs[1][1]};
+    vertices[22] = {center.x + halfWidth, center.y - halfHeight, center.z + halfDepth, uvs[2][0], uvs[2][1]};
+    vertices[23] = {center.x - halfWidth, center.y - halfHeight, center.z + halfDepth, uvs[3][0], uvs[3][1]};
+}
+
+// Function to create indices for the box with 24 vertices
+constexpr void createBoxIndices(unsigned int* indices) {
+    unsigned int tempIndices[] = {
+        // Front face
+        0, 1, 2, 2, 3, 0,
+        // Back face
+        4, 5, 6, 6, 7, 4,
+        // Left face
+        8, 9, 10, 10, 11, 8,
+        // Right face
+        12, 13, 14, 14, 15, 12,
+        // Top face
+        16, 17, 18, 18, 19, 16,
+        // Bottom face
+        20, 21, 22, 22, 23, 20
+    };
+
+    for (int i = 0; i < 36; i++) {
+        indices[i] = tempIndices[i];
+    }
+}
+
+// Function to create vertices of a textured pyramid
+inline void createTexturedPyramid(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, const Vertex& center, float baseSize, float pyramidHeight) {
+    float halfBase = baseSize / 2.0f;
+    float halfHeight = pyramidHeight / 2.0f;
+
+    // Define the 5 unique positions
+    Vertex v0 = { center.x - halfBase, center.y - halfHeight, center.z + halfBase, 0.0f, 0.0f }; // Front-left base
+    Vertex v1 = { center.x + halfBase, center.y - halfHeight, center.z + halfBase, 0.0f, 0.0f }; // Front-right base
+    Vertex v2 = { center.x + halfBase, center.y - halfHeight, center.z - halfBase, 0.0f, 0.0f }; // Back-right base
+    Vertex v3 = { center.x - halfBase, center.y - halfHeight, center.z - halfBase, 0.0f, 0.0f }; // Back-left base
+    Vertex v4 = { center.x, center.y + halfHeight, center.z, 0.0f, 0.0f };                       // Apex
+
+    // Texture coordinates
+    float texCoords[3][2] = {
+        { 0.0f, 0.0f }, // Bottom-left
+        { 1.0f, 0.0f }, // Bottom-right
+        { 0.5f, 1.0f }  // Top-center
+    };
+
+    // Base face (two triangles)
+    // Triangle 1
+    vertices.push_back({ v0.x, v0.y, v0.z, 0.0f, 0.0f }); // v0
+    vertices.push_back({ v1.x, v1.y, v1.z, 1.0f, 0.0f }); // v1
+    vertices.push_back({ v2.x, v2.y, v2.z, 1.0f, 1.0f }); // v2
+
+    // Triangle 2
+    vertices.push_back({ v2.x, v2.y, v2.z, 1.0f, 1.0f }); // v2
+    vertices.push_back({ v3.x, v3.y, v3.z, 0.0f, 1.0f }); // v3
+    vertices.push_back({ v0.x, v0.y, v0.z, 0.0f, 0.0f }); // v0
+
+    // Indices for the base
+    for (unsigned int i = 0; i < 6; ++i) {
+        indices.push_back(i);
+    }
+
+    // Side faces
+    // Face 1
+    vertices.push_back({ v0.x, v0.y, v0.z, texCoords[0][0], texCoords[0][1] }); // v0
+    vertices.push_back({ v1.x, v1.y, v1.z, texCoords[1][0], texCoords[1][1] }); // v1
+    vertices.push_back({ v4.x, v4.y, v4.z, texCoords[2][0], texCoords[2][1] }); // v4
+
+    // Face 2
+    vertices.push_back({ v1.x, v1.y, v1.z, texCoords[0][0], texCoords[0][1] }); // v1
+    vertices.push_back({ v2.x, v2.y, v2.z, texCoords[1][0], texCoords[1][1] }); // v2
+    vertices.push_back({ v4.x, v4.y, v4.z, texCoords[2][0], texCoords[2][1] }); // v4
+
+    // Face 3
+    vertices.push_back({ v2.x, v2.y, v2.z, texCoords[0][0], texCoords[0][1] }); // v2
+    vertices.push_back({ v3.x, v3.y, v3.z, texCoords[1][0], texCoords[1][1] }); // v3
+    vertices.push_back({ v4.x, v4.y, v4.z, texCoords[2][0], texCoords[2][1] }); // v4
+
+    // Face 4
+    vertices.push_back({ v3.x, v3.y, v3.z, texCoords[0][0], texCoords[0][1] }); // v3
+    vertices.push_back({ v0.x, v0.y, v0.z, texCoords[1][0], texCoords[1][1] }); // v0
+    vertices.push_back({ v4.x, v4.y, v4.z, texCoords[2][0], texCoords[2][1] }); // v4
+
+    // Indices for the sides
+    for (unsigned int i = 6; i < 18; ++i) {
+        indices.push_back(i);
+    }
+}
+
+// Both sphere generators are compiled without FP contraction (a*b+c fused into an
+// FMA), so they round identically whatever -march the including file uses
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+// Function to create vertices of a textured sphere using stack-and-sector method
+inline void createSphereVertices(
+    std::vector<Vertex>& vertices,
+    std::vector<unsigned int>& indices,
+    float radius,
+    unsigned int sectorCount,
+    unsigned int stackCount)
+{
+    const float PI = 3.14159265359f;
+    float x, y, z, xy;                          // Vertex position
+    float u, v;                                  // Texture coordinates
+    float sectorStep = 2 * PI / sectorCount;
+    float stackStep = PI / stackCount;
+    float sectorAngle, stackAngle;
+
+    for (unsigned int i = 0; i <= stackCount; ++i)
+    {
+        stackAngle = PI / 2 - i * stackStep;        // From pi/2 to -pi/2
+        xy = radius * cosf(stackAngle);             // r * cos(u)
+        y = radius * sinf(stackAngle);              // r * sin(u)
+
+        for (unsigned int j = 0; j <= sectorCount; ++j)
+        {
+            sectorAngle = j * sectorStep;           // From 0 to 2pi
+
+            // Vertex position
+            x = xy * cosf(sectorAngle);             // x = r * cos(u) * cos(v)
+            z = xy * sinf(sectorAngle);             // z = r * cos(u) * sin(v)
+
+            // Texture coordinates
+            u = (float)j / sectorCount;
+            v = (float)i / stackCount;
+
+            vertices.push_back({ x, y, z, u, v });
+        }
+    }
+
+    // Generate indices
+    unsigned int k1, k2;
+    for (unsigned int i = 0; i < stackCount; ++i)
+    {
+        k1 = i * (sectorCount + 1);     // Beginning of current stack
+        k2 = k1 + sectorCount + 1;      // Beginning of next stack
+
+        for (unsigned int j = 0; j < sectorCount; ++j, ++k1, ++k2)
+        {
+            // Two triangles per sector except for the first and last stacks
+            if (i != 0)
+            {
+                // k1, k2, k1+1
+                indices.push_back(k1);
+                indices.push_back(k2);
+                indices.push_back(k1 + 1);
+            }
+
+            if (i != (stackCount - 1))
+            {
+                // k1+1, k2, k2+1
+                indices.push_back(k1 + 1);
+                indices.push_back(k2);
+                indices.push_back(k2 + 1);
+            }
+        }
+    }
+}
+
+// Index layouts createSphereVerticesFast can emit
+enum class SphereIndexMode
+{
+    Triangles,  // GL_TRIANGLES, same indices as createSphereVertices
+    Strips      // GL_TRIANGLE_STRIP, one strip per stack separated by SPHERE_RESTART_INDEX
+};
+
+// Primitive restart index for SphereIndexMode::Strips (glPrimitiveRestartIndex)
+const unsigned int SPHERE_RESTART_INDEX = 0xFFFFFFFFu;
+
+// Number of indices createSphereVertices emits (the two pole stacks have one triangle per sector)
+inline size_t sphereIndexCount(unsigned int sectorCount, unsigned int stackCount)
+{
+    return stackCount < 2 ? 0 : (size_t)6 * sectorCount * (stackCount - 1);
+}
+
+// Strip mode: 2 indices per column per stack plus one restart between stacks
+inline size_t sphereStripIndexCount(unsigned int sectorCount, unsigned int stackCount)
+{
+    return stackCount == 0 ? 0 : (size_t)stackCount * 2 * (sectorCount + 1) + (stackCount - 1);
+}
+
+// Same output as createSphereVertices, bit for bit, but faster for large counts:
+// the sector sin/cos table is computed once and reused by every stack, the
+// outputs are sized exactly up front and stacks are filled in parallel.
+// SphereIndexMode::Strips emits triangle strips instead (about a third of the
+// indices); the pole stacks then include zero-area triangles, which the GPU
+// discards during setup.
+inline void createSphereVerticesFast(
+    std::vector<Vertex>& vertices,
+    std::vector<unsigned int>& indices,
+    float radius,
+    unsigned int sectorCount,
+    unsigned int stackCount,
+    SphereIndexMode mode = SphereIndexMode::Triangles)
+{
+    const float PI = 3.14159265359f;
+    float sectorStep = 2 * PI / sectorCount;
+    float stackStep = PI / stackCount;
+    size_t rowLength = (size_t)sectorCount + 1;
+
+    // Sector table; identical expressions to the reference so results match exactly
+    std::vector<float> sectorCos(rowLength), sectorSin(rowLength), sectorU(rowLength);
+    for (unsigned int j = 0; j <= sectorCount; ++j)
+    {
+        float sectorAngle = j * sectorStep;         // From 0 to 2pi
+        sectorCos[j] = cosf(sectorAngle);
+        sectorSin[j] = sinf(sectorAngle);
+        sectorU[j] = (float)j / sectorCount;
+    }
+
+    size_t vertexBase = vertices.size();
+    size_t indexBase = indices.size();
+    vertices.resize(vertexBase + rowLength * (stackCount + 1));
+    bool strips = mode == SphereIndexMode::Strips;
+    indices.resize(indexBase + (strips ? sphereStripIndexCount(sectorCount, stackCount)
+                                       : sphereIndexCount(sectorCount, stackCount)));
+    Vertex* outVertices = vertices.data() + vertexBase;
+    unsigned int* outIndices = indices.data() + indexBase;
+
+    // Each job fills a band of stacks: its vertex rows and the triangles below them
+    const unsigned int STACKS_PER_JOB = 16;
+    size_t jobCount = (stackCount + STACKS_PER_JOB) / STACKS_PER_JOB;
+    auto fillStacks = [&](size_t job, unsigned)
+    {
+        unsigned int first = (unsigned int)job * STACKS_PER_JOB;
+        unsigned int last = std::min(first + STACKS_PER_JOB, stackCount + 1);
+        for (unsigned int i = first; i < last; ++i)
+        {
+            float stackAngle = PI / 2 - i * stackStep;  // From pi/2 to -pi/2
+            float xy = radius * cosf(stackAngle);       // r * cos(u)
+            float y = radius * sinf(stackAngle);        // r * sin(u)
+            float v = (float)i / stackCount;
+
+            Vertex* row = outVertices + i * rowLength;
+            for (unsigned int j = 0; j <= sectorCount; ++j)
+                row[j] = { xy * sectorCos[j], y, xy * sectorSin[j], sectorU[j], v };
+
+            if (i == stackCount)
+                continue;
+
+            if (strips)
+            {
+                // Alternating current/next stack gives the same winding as the triangle list
+                unsigned int* strip = outIndices + (size_t)i * (2 * rowLength + 1);
+                unsigned int k1 = i * (sectorCount + 1);
+                unsigned int k2 = k1 + sectorCount + 1;
+                for (unsigned int j = 0; j <= sectorCount; ++j)
+                {
+                    *strip++ = k1 + j;
+                    *strip++ = k2 + j;
+                }
+                if (i != stackCount - 1)
+                    *strip = SPHERE_RESTART_INDEX;
+                continue;
+            }
+
+            // Stack 0 emits one triangle per sector, every later stack two
+            unsigned int* out = outIndices + (i == 0 ? 0 : (size_t)3 * sectorCount * (2 * i - 1));
+            unsigned int k1 = i * (sectorCount + 1);    // Beginning of current stack
+            unsigned int k2 = k1 + sectorCount + 1;     // Beginning of next stack
+            for (unsigned int j = 0; j < sectorCount; ++j, ++k1, ++k2)
+            {
+                if (i != 0)
+                {
+                    *out++ = k1;
+                    *out++ = k2;
+                    *out++ = k1 + 1;
+                }
+                if (i != (stackCount - 1))
+                {
+                    *out++ = k1 + 1;
+                    *out++ = k2;
+                    *out++ = k2 + 1;
+                }
+            }
+        }
+    };
+
+    // Small spheres are cheaper to build than to hand out to the pool
+    if (rowLength * (stackCount + 1) < 16384)
+    {
+        for (size_t job = 0; job < jobCount; ++job)
+            fillStacks(job, 0);
+    }
+    else
+    {
+        defaultThreadPool().run(jobCount, fillStacks);
+    }
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+// Largest distance between a stack/sector sphere and its tessellation: the
+// middle of an equatorial quad, which sits inside the sphere by this much
+inline float sphereTessellationError(float radius, unsigned int sectorCount, unsigned int stackCount)
+{
+    const float PI = 3.14159265359f;
+    return radius * (1.0f - cosf(PI / sectorCount) * cosf(PI / (2.0f * stackCount)));
+}
+
+// One level of detail inside a shared vertex/index buffer. Its indices count
+// from its own first vertex, so it is drawn with a base vertex of baseVertex.
+struct MeshLod
+{
+    float error;                // Geometric error in mesh units
+    size_t baseVertex, vertexCount;
+    size_t firstIndex, indexCount;
+    size_t triangleCount;       // Without the zero-area triangles of strips
+};
+
+// Level 0 is sectorCount x stackCount; each further level has the most
+// sectors (stacks in the same proportion) whose error is at least
+// levelErrorRatio times the previous level's, down to minSectorCount sectors.
+// All levels are appended to vertices/indices, one after the other.
+inline std::vector<MeshLod> createSphereLodChain(
+    std::vector<Vertex>& vertices,
+    std::vector<unsigned int>& indices,
+    float radius,
+    unsigned int sectorCount,
+    unsigned int stackCount,
+    SphereIndexMode mode = SphereIndexMode::Triangles,
+    float levelErrorRatio = 2.0f,
+    unsigned int minSectorCount = 6)
+{
+    std::vector<MeshLod> levels;
+    unsigned int sectors = sectorCount, stacks = stackCount;
+    for (;;)
+    {
+        MeshLod level;
+        level.error = sphereTessellationError(radius, sectors, stacks);
+        level.baseVertex = vertices.size();
+        level.firstIndex = indices.size();
+        level.triangleCount = sphereIndexCount(sectors, stacks) / 3;
+        createSphereVerticesFast(vertices, indices, radius, sectors, stacks, mode);
+        level.vertexCount = vertices.size() - level.baseVertex;
+        level.indexCount = indices.size() - level.firstIndex;
+        levels.push_back(level);
+
+        if (sectors <= minSectorCount)
+            break;
+        float targetError = level.error * levelErrorRatio;
+        do
+        {
+            --sectors;
+            stacks = std::max(2u, (sectors * stackCount + sectorCount / 2) / sectorCount);
+        } while (sectors > minSectorCount && sphereTessellationError(radius, sectors, stacks) < targetError);
+    }
+    return levels;
+}
+
+// Function to create vertices of a textured sphere by subdividing an icosahedron.
+// Its triangles are close to equal in size all over the sphere, where the
+// stack-and-sector method crowds them at the poles, so it needs fewer of them
+// for the same largest geometric error (see "icosphere" in bench.cpp).
+// Each subdivision splits every triangle into four; the new vertex on an edge
+// is cached by the edge's endpoints so both triangles sharing the edge use it.
+// Texture coordinates and winding follow createSphereVertices (u around the
+// Y axis from +X towards +Z, v from the top pole). Triangles that cross the
+// u = 0/1 seam get copies of their low-u vertices with u + 1, and each
+// triangle at a pole gets its own copy of the pole with the u of its middle.
+// Output: 20 * 4^subdivisions triangles as a GL_TRIANGLES list.
+inline void createIcosphereVertices(
+    std::vector<Vertex>& vertices,
+    std::vector<unsigned int>& indices,
+    float radius,
+    unsigned int subdivisions)
+{
+    const float PI = 3.14159265359f;
+
+    // Icosahedron with a vertex at each pole and two rings of five, 36 degrees apart
+    std::vector<Vertex> unit;   // Unit-length positions, texture coordinates filled in last
+    unit.push_back({ 0.0f, 1.0f, 0.0f, 0.0f, 0.0f });
+    float ringY = 1.0f / sqrtf(5.0f), ringXz = 2.0f / sqrtf(5.0f);     // Latitude atan(1/2)
+    for (int i = 0; i < 5; ++i)
+        unit.push_back({ ringXz * cosf(i * 2 * PI / 5), ringY, ringXz * sinf(i * 2 * PI / 5), 0.0f, 0.0f });
+    for (int i = 0; i < 5; ++i)
+        unit.push_back({ ringXz * cosf((i + 0.5f) * 2 * PI / 5), -ringY, ringXz * sinf((i + 0.5f) * 2 * PI / 5),
+                          0.0f, 0.0f });
+    unit.push_back({ 0.0f, -1.0f, 0.0f, 0.0f, 0.0f });
+    const unsigned int TOP = 0, BOTTOM = 11;
+
+    std::vector<unsigned int> triangles;
+    for (unsigned int i = 0; i < 5; ++i)
+    {
+        unsigned int upper = 1 + i, nextUpper = 1 + (i + 1) % 5;
+        unsigned int lower = 6 + i, nextLower = 6 + (i + 1) % 5;
+        unsigned int faces[4][3] = {
+            { TOP, upper, nextUpper },
+            { upper, lower, nextUpper },
+            { nextUpper, lower, nextLower },
+            { lower, BOTTOM, nextLower }
+        };
+        for (const auto& face : faces)
+            triangles.insert(triangles.end(), face, face + 3);
+    }
+
+    // Split each triangle into four; winding is kept, so the base faces decide it for all
+    for (unsigned int level = 0; level < subdivisions; ++level)
+    {
+        std::unordered_map<uint64_t, unsigned int> midpoints;
+        midpoints.reserve(triangles.size() / 2);
+        auto midpoint = [&](unsigned int a, unsigned int b)
+        {
+            uint64_t key = ((uint64_t)std::min(a, b) << 32) | std::max(a, b);
+            auto found = midpoints.find(key);
+            if (found != midpoints.end())
+                return found->second;
+            float x = unit[a].x + unit[b].x, y = unit[a].y + unit[b].y, z = unit[a].z + unit[b].z;
+            float scale = 1.0f / sqrtf(x * x + y * y + z * z);
+            unit.push_back({ x * scale, y * scale, z * scale, 0.0f, 0.0f });
+            unsigned int index = (unsigned int)unit.size() - 1;
+            midpoints.emplace(key, index);
+            return index;
+        };
+
+        std::vector<unsigned int> split;
+        split.reserve(triangles.size() * 4);
+        for (size_t t = 0; t < triangles.size(); t += 3)
+        {
+            unsigned int a = triangles[t], b = triangles[t + 1], c = triangles[t + 2];
+            unsigned int ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+            unsigned int children[12] = { a, ab, ca, ab, b, bc, ca, bc, c, ab, bc, ca };
+            split.insert(split.end(), children, children + 12);
+        }
+        triangles.swap(split);
+    }
+
+    // Texture coordinates as createSphereVertices computes them from the angles
+    for (Vertex& p : unit)
+    {
+        float u = atan2f(p.z, p.x) / (2 * PI);
+        p.u = u < 0.0f ? u + 1.0f : u;
+        p.v = acosf(std::max(-1.0f, std::min(1.0f, p.y))) / PI;
+    }
+
+    // Seam and pole copies, then only the vertices still referenced are emitted
+    std::vector<unsigned int> seamCopy(unit.size(), ~0u);
+    for (size_t t = 0; t < triangles.size(); t += 3)
+    {
+        unsigned int* corner = &triangles[t];
+        float lowU = 1.0f, highU = 0.0f;
+        for (int k = 0; k < 3; ++k)
+        {
+            if (corner[k] == TOP || corner[k] == BOTTOM)
+                continue;
+            lowU = std::min(lowU, unit[corner[k]].u);
+            highU = std::max(highU, unit[corner[k]].u);
+        }
+        if (highU - lowU > 0.5f)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                unsigned int index = corner[k];
+                if (index == TOP || index == BOTTOM || unit[index].u >= 0.5f)
+                    continue;
+                if (seamCopy[index] == ~0u)
+                {
+                    Vertex copy = unit[index];
+                    copy.u += 1.0f;
+                    seamCopy[index] = (unsigned int)unit.size();
+                    unit.push_back(copy);
+                }
+                corner[k] = seamCopy[index];
+            }
+        }
+        for (int k = 0; k < 3; ++k)
+        {
+            if (corner[k] != TOP && corner[k] != BOTTOM)
+                continue;
+            Vertex pole = unit[corner[k]];
+            pole.u = (unit[corner[(k + 1) % 3]].u + unit[corner[(k + 2) % 3]].u) * 0.5f;
+            corner[k] = (unsigned int)unit.size();
+            unit.push_back(pole);
+        }
+    }
+
+    size_t vertexBase = vertices.size();
+    std::vector<unsigned int> remap(unit.size(), ~0u);
+    for (unsigned int& index : triangles)
+    {
+        if (remap[index] == ~0u)
+        {
+            const Vertex& p = unit[index];
+            remap[index] = (unsigned int)(vertices.size() - vertexBase);
+            vertices.push_back({ p.x * radius, p.y * radius, p.z * radius, p.u, p.v });
+        }
+        indices.push_back(remap[index]);
+    }
+}
+
+// Expand a triangle strip (with restart indices) into a triangle list, for
+// consumers that only draw lists. Odd triangles are flipped to keep the winding
+// and triangles that repeat an index are dropped.
+inline void triangleStripToList(const std::vector<unsigned int>& strip, unsigned int restartIndex,
+                                std::vector<unsigned int>& triangles)
+{
+    size_t start = 0;
+    for (size_t n = 0; n <= strip.size(); ++n)
+    {
+        if (n < strip.size() && strip[n] != restartIndex)
+            continue;
+
+        for (size_t k = start; k + 2 < n; ++k)
+        {
+            unsigned int a = strip[k], b = strip[k + 1], c = strip[k + 2];
+            if (a == b || b == c || a == c)
+                continue;
+            if ((k - start) & 1)
+                std::swap(a, b);
+            triangles.push_back(a);
+            triangles.push_back(b);
+            triangles.push_back(c);
+        }
+        start = n + 1;
+    }
+}
@@ -0,0 +1,348 @@
+#pragma once
+
+// Mesh optimization passes for indexed Vertex meshes (generated or imported)
+
+#include "vertex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Vertex/index counts and buffer sizes before and after a pass
+struct MeshReport {
+    size_t verticesBefore = 0, verticesAfter = 0;
+    size_t bytesBefore = 0, bytesAfter = 0;     // Vertex buffer + index buffer
+};
+
+inline void printMeshReport(const char* label, const MeshReport& report) {
+    printf("%s: %zu -> %zu vertices, %zu -> %zu bytes (vertex + index data)\n",
+           label, report.verticesBefore, report.verticesAfter, report.bytesBefore, report.bytesAfter);
+}
+
+// Hash of all Vertex attributes; -0.0 and 0.0 hash (and compare) the same
+inline uint32_t hashVertex(const Vertex& v) {
+    const float* f = &v.x;
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < 5; ++i) {
+        uint32_t bits;
+        float value = f[i] == 0.0f ? 0.0f : f[i];
+        memcpy(&bits, &value, sizeof(bits));
+        h = (h ^ bits) * 16777619u;
+        h ^= h >> 15;
+    }
+    return h;
+}
+
+inline bool sameVertex(const Vertex& a, const Vertex& b) {
+    return a.x == b.x && a.y == b.y && a.z == b.z && a.u == b.u && a.v == b.v;
+}
+
+// Weld exact duplicates (every attribute equal) and rewrite the indices to match.
+// Surviving vertices keep their first-occurrence order. layers (optional) holds a
+// texture array layer per vertex; vertices on different layers are never welded
+// and the array is compacted along with the vertices.
+inline MeshReport weldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+                               std::vector<uint8_t>* layers = nullptr) {
+    MeshReport report;
+    report.verticesBefore = vertices.size();
+    report.bytesBefore = vertices.size() * sizeof(Vertex) + indices.size() * sizeof(unsigned int);
+
+    // Open-addressing table of welded vertex indices, at most half full
+    size_t tableSize = 16;
+    while (tableSize < vertices.size() * 2)
+        tableSize *= 2;
+    const unsigned int EMPTY = ~0u;
+    std::vector<unsigned int> table(tableSize, EMPTY);
+    std::vector<unsigned int> remap(vertices.size());
+
+    size_t welded = 0;
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        const Vertex& v = vertices[i];
+        uint8_t layer = layers ? (*layers)[i] : 0;
+        size_t slot = (hashVertex(v) ^ layer * 0x9E3779B9u) & (tableSize - 1);
+        while (table[slot] != EMPTY &&
+               (!sameVertex(vertices[table[slot]], v) || (layers && (*layers)[table[slot]] != layer)))
+            slot = (slot + 1) & (tableSize - 1);
+
+        if (table[slot] == EMPTY) {
+            // First occurrence: compact it into place (welded <= i, so it is never read again)
+            vertices[welded] = v;
+            if (layers)
+                (*layers)[welded] = layer;
+            table[slot] = (unsigned int)welded;
+            ++welded;
+        }
+        remap[i] = table[slot];
+    }
+    vertices.resize(welded);
+    if (layers)
+        layers->resize(welded);
+
+    for (unsigned int& index : indices)
+        index = remap[index];
+
+    report.verticesAfter = vertices.size();
+    report.bytesAfter = vertices.size() * sizeof(Vertex) + indices.size() * sizeof(unsigned int);
+    return report;
+}
+
+// Post-transform cache statistics: ACMR = transformed vertices per triangle,
+// ATVR = transformed vertices per referenced vertex (1.0 is optimal)
+struct VertexCacheStats {
+    size_t transforms = 0;
+    float acmr = 0.0f, atvr = 0.0f;
+};
+
+// Simulate a FIFO post-transform cache of cacheSize entries over an indexed triangle list
+inline VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount,
+                                           unsigned int cacheSize = 16) {
+    VertexCacheStats stats;
+    // A FIFO only evicts on misses, so a vertex is resident while fewer than
+    // cacheSize misses have happened since it was inserted
+    std::vector<size_t> insertedAt(vertexCount, 0);     // Miss count after insertion, 0 = never
+    std::vector<bool> referenced(vertexCount, false);
+    size_t referencedCount = 0;
+
+    for (unsigned int index : indices) {
+        if (!referenced[index]) {
+            referenced[index] = true;
+            ++referencedCount;
+        }
+        bool hit = insertedAt[index] != 0 && stats.transforms - insertedAt[index] < cacheSize;
+        if (!hit) {
+            ++stats.transforms;
+            insertedAt[index] = stats.transforms;
+        }
+    }
+
+    size_t triangles = indices.size() / 3;
+    stats.acmr = triangles ? (float)stats.transforms / triangles : 0.0f;
+    stats.atvr = referencedCount ? (float)stats.transforms / referencedCount : 0.0f;
+    return stats;
+}
+
+inline void printVertexCacheStats(const char* label, const VertexCacheStats& before, const VertexCacheStats& after) {
+    printf("%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", label, before.acmr, after.acmr, before.atvr, after.atvr);
+}
+
+// Reorder triangles for the post-transform vertex cache (Tom Forsyth's
+// "Linear-Speed Vertex Cache Optimisation"). The triangle set and winding are unchanged.
+inline void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount) {
+    const int CACHE_SIZE = 32;
+    const float CACHE_DECAY_POWER = 1.5f;
+    const float LAST_TRIANGLE_SCORE = 0.75f;
+    const float VALENCE_BOOST_SCALE = 2.0f;
+    const float VALENCE_BOOST_POWER = 0.5f;
+
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // Score tables indexed by cache position and by remaining valence
+    float cacheScore[CACHE_SIZE];
+    for (int i = 0; i < CACHE_SIZE; ++i) {
+        if (i < 3)
+            cacheScore[i] = LAST_TRIANGLE_SCORE;
+        else
+            cacheScore[i] = powf(1.0f - (float)(i - 3) / (CACHE_SIZE - 3), CACHE_DECAY_POWER);
+    }
+    const int VALENCE_TABLE = 64;
+    float valenceScore[VALENCE_TABLE];
+    for (int i = 0; i < VALENCE_TABLE; ++i)
+        valenceScore[i] = i == 0 ? 0.0f : VALENCE_BOOST_SCALE * powf((float)i, -VALENCE_BOOST_POWER);
+
+    auto vertexScore = [&](int cachePosition, unsigned int remaining) {
+        if (remaining == 0)
+            return -1.0f;
+        float score = cachePosition >= 0 ? cacheScore[cachePosition] : 0.0f;
+        return score + (remaining < (unsigned int)VALENCE_TABLE ? valenceScore[remaining]
+                                                                : VALENCE_BOOST_SCALE * powf((float)remaining, -VALENCE_BOOST_POWER));
+    };
+
+    // Vertex -> triangle adjacency (CSR)
+    std::vector<unsigned int> remaining(vertexCount, 0);
+    for (unsigned int index : indices)
+        ++remaining[index];
+    std::vector<size_t> adjacencyStart(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v)
+        adjacencyStart[v + 1] = adjacencyStart[v] + remaining[v];
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<size_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+    for (size_t t = 0; t < triangleCount; ++t)
+        for (int k = 0; k < 3; ++k)
+            adjacency[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        score[v] = vertexScore(-1, remaining[v]);
+
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    for (size_t t = 0; t < triangleCount; ++t)
+        triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+
+    // Adjacency lists shrink as triangles are emitted: live entries are the first remaining[v]
+    auto removeTriangle = [&](unsigned int v, unsigned int t) {
+        unsigned int* list = &adjacency[adjacencyStart[v]];
+        for (unsigned int i = 0; i < remaining[v]; ++i) {
+            if (list[i] == t) {
+                list[i] = list[remaining[v] - 1];
+                --remaining[v];
+                return;
+            }
+        }
+    };
+
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+    unsigned int cache[CACHE_SIZE + 3];
+    int cacheCount = 0;
+
+    size_t scanCursor = 0;
+    long best = 0;
+    float bestScore = triangleScore[0];
+    for (size_t t = 1; t < triangleCount; ++t) {
+        if (triangleScore[t] > bestScore) {
+            bestScore = triangleScore[t];
+            best = (long)t;
+        }
+    }
+
+    for (size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount) {
+        if (best < 0) {
+            // Dead end: nothing in the cache has triangles left, take the next unemitted one
+            while (emitted[scanCursor])
+                ++scanCursor;
+            best = (long)scanCursor;
+        }
+
+        unsigned int t = (unsigned int)best;
+        const unsigned int* tri = &indices[(size_t)t * 3];
+        emitted[t] = true;
+        output.insert(output.end(), tri, tri + 3);
+        for (int k = 0; k < 3; ++k)
+            removeTriangle(tri[k], t);
+
+        // New LRU cache: this triangle's vertices first, then the old contents minus them
+        unsigned int newCache[CACHE_SIZE + 3];
+        int newCount = 0;
+        for (int k = 0; k < 3; ++k)
+            newCache[newCount++] = tri[k];
+        for (int i = 0; i < cacheCount; ++i) {
+            unsigned int v = cache[i];
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                newCache[newCount++] = v;
+        }
+
+        // Rescore every vertex that entered, moved in or fell out of the cache
+        for (int i = 0; i < newCount; ++i) {
+            unsigned int v = newCache[i];
+            cachePosition[v] = i < CACHE_SIZE ? i : -1;
+            float newScore = vertexScore(cachePosition[v], remaining[v]);
+            float delta = newScore - score[v];
+            score[v] = newScore;
+            const unsigned int* list = &adjacency[adjacencyStart[v]];
+            for (unsigned int a = 0; a < remaining[v]; ++a)
+                triangleScore[list[a]] += delta;
+        }
+        cacheCount = std::min(newCount, CACHE_SIZE);
+        memcpy(cache, newCache, cacheCount * sizeof(unsigned int));
+
+        // Best candidate among triangles touching the cache
+        best = -1;
+        bestScore = -1.0f;
+        for (int i = 0; i < cacheCount; ++i) {
+            unsigned int v = cache[i];
+            const unsigned int* list = &adjacency[adjacencyStart[v]];
+            for (unsigned int a = 0; a < remaining[v]; ++a) {
+                if (triangleScore[list[a]] > bestScore) {
+                    bestScore = triangleScore[list[a]];
+                    best = (long)list[a];
+                }
+            }
+        }
+    }
+
+    indices.swap(output);
+}
+
+// Reorder vertices by first use in the index buffer so fetches walk memory
+// forwards; unreferenced vertices are dropped.
+inline MeshReport optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    MeshReport report;
+    report.verticesBefore = vertices.size();
+    report.bytesBefore = vertices.size() * sizeof(Vertex) + indices.size() * sizeof(unsigned int);
+
+    const unsigned int UNUSED = ~0u;
+    std::vector<unsigned int> remap(vertices.size(), UNUSED);
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+    for (unsigned int& index : indices) {
+        if (remap[index] == UNUSED) {
+            remap[index] = (unsigned int)reordered.size();
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(reordered);
+
+    report.verticesAfter = vertices.size();
+    report.bytesAfter = vertices.size() * sizeof(Vertex) + indices.size() * sizeof(unsigned int);
+    return report;
+}
+
+// One piece of a mesh cut by splitMesh, with its own vertex numbering
+struct MeshPart {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+};
+
+// Cut a triangle list into parts of at most maxVertices vertices each (the
+// default fits 16-bit index buffers). Triangles stay in order and are never
+// cut; vertices shared across a cut are duplicated into both parts.
+inline std::vector<MeshPart> splitMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+                                       size_t maxVertices = 0xFFFF) {
+    std::vector<MeshPart> parts;
+    if (maxVertices < 3)
+        return parts;
+
+    // remap[v] is v's index in the current part; stamp[v] says which part set it
+    std::vector<unsigned int> remap(vertices.size());
+    std::vector<unsigned int> stamp(vertices.size(), ~0u);
+    unsigned int partId = 0;
+    parts.emplace_back();
+
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        int newVertices = 0;
+        for (int k = 0; k < 3; ++k) {
+            unsigned int v = indices[t + k];
+            bool seen = stamp[v] == partId;
+            for (int prev = 0; prev < k && !seen; ++prev)
+                seen = indices[t + prev] == v;
+            newVertices += seen ? 0 : 1;
+        }
+        if (parts.back().vertices.size() + newVertices > maxVertices) {
+            parts.emplace_back();
+            ++partId;
+        }
+
+        MeshPart& part = parts.back();
+        for (int k = 0; k < 3; ++k) {
+            unsigned int v = indices[t + k];
+            if (stamp[v] != partId) {
+                stamp[v] = partId;
+                remap[v] = (unsigned int)part.vertices.size();
+                part.vertices.push_back(vertices[v]);
+            }
+            part.indices.push_back(remap[v]);
+        }
+    }
+
+    if (parts.back().indices.empty())
+        parts.pop_back();
+    return parts;
+}
@@ -0,0 +1,145 @@
+// Asset packer: puts everything the Lab4 demos load at startup into one .pak
+// (see asset_pack.h), which they map with a single open.
+//
+// Build: g++ -O2 -std=c++17 pack.cpp -o pack
+// Usage: ./pack [-o lab4.pak] [directory]
+//
+// Images (.jpg, .png, .bmp, .tga) are stored as their baked .ctex when texbake
+// has produced an up-to-date one, otherwise as the encoded file. Shader sources
+// (.vert, .frag, .glsl) are stored as text. The pyramid and the default spheres
+// are generated and optimized here and stored ready to upload.
+
+#include "asset_pack.h"
+#include "baked_mesh.h"
+#include "baked_texture.h"
+#include "mesh.h"
+#include "mesh_opt.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static bool readFile(const fs::path& path, std::vector<unsigned char>& data) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return !file.bad();
+}
+
+static bool hasExtension(const fs::path& path, std::initializer_list<const char*> extensions) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    for (const char* candidate : extensions) {
+        if (extension == candidate)
+            return true;
+    }
+    return false;
+}
+
+static void printAsset(const AssetPackInput& asset) {
+    const char* types[] = { "raw", "image", "baked", "mesh", "shader" };
+    printf("%-28s %-7s %8zu bytes\n", asset.name.c_str(), types[(int)asset.type], asset.data.size());
+}
+
+// Same meshes as Lab3_pyramid.cpp and Lab3_sphere.cpp build at startup; keep the parameters in sync
+static void addMeshes(std::vector<AssetPackInput>& assets) {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    createTexturedPyramid(vertices, indices, { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f }, 1.0f, 1.0f);
+    weldVertices(vertices, indices);
+    assets.push_back({ PYRAMID_MESH_ASSET, AssetType::Mesh, bakeMesh(vertices, indices, 0) });
+    printAsset(assets.back());
+
+    const unsigned int sectorCount = 36, stackCount = 18;
+    const float radius = 0.5f;
+    for (bool strips : { true, false }) {
+        vertices.clear();
+        indices.clear();
+        createSphereVerticesFast(vertices, indices, radius, sectorCount, stackCount,
+                                 strips ? SphereIndexMode::Strips : SphereIndexMode::Triangles);
+        if (!strips) {
+            optimizeVertexCache(indices, vertices.size());
+            optimizeVertexFetch(vertices, indices);
+        }
+        assets.push_back({ sphereMeshAssetName(sectorCount, stackCount, strips), AssetType::Mesh,
+                           bakeMesh(vertices, indices, strips ? SPHERE_RESTART_INDEX : 0) });
+        printAsset(assets.back());
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const char* output = "lab4.pak";
+    fs::path directory = ".";
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            output = argv[++i];
+        else
+            directory = argv[i];
+    }
+
+    std::vector<AssetPackInput> assets;
+    std::error_code error;
+    int failed = 0;
+    for (const fs::directory_entry& file : fs::directory_iterator(directory, error)) {
+        if (!file.is_regular_file())
+            continue;
+        const fs::path& path = file.path();
+        AssetPackInput asset;
+        asset.name = path.filename().string();
+
+        if (hasExtension(path, { ".jpg", ".jpeg", ".png", ".bmp", ".tga" })) {
+            // Prefer the baked texture, unless the image was edited after baking
+            fs::path baked = bakedTexturePath(path.string());
+            std::error_code timeError;
+            auto bakedTime = fs::last_write_time(baked, timeError);
+            if (!timeError && bakedTime >= fs::last_write_time(path, timeError) && !timeError &&
+                readFile(baked, asset.data)) {
+                asset.type = AssetType::Texture;
+            }
+            else {
+                asset.type = AssetType::Image;
+                if (!readFile(path, asset.data)) {
+                    fprintf(stderr, "%s: could not read\n", path.string().c_str());
+                    ++failed;
+                    continue;
+                }
+            }
+        }
+        else if (hasExtension(path, { ".vert", ".frag", ".glsl" })) {
+            asset.type = AssetType::Shader;
+            if (!readFile(path, asset.data)) {
+                fprintf(stderr, "%s: could not read\n", path.string().c_str());
+                ++failed;
+                continue;
+            }
+        }
+        else {
+            continue;
+        }
+        printAsset(asset);
+        assets.push_back(std::move(asset));
+    }
+    if (error) {
+        fprintf(stderr, "%s: %s\n", directory.string().c_str(), error.message().c_str());
+        return 1;
+    }
+
+    addMeshes(assets);
+
+    if (!writeAssetPack(output, assets)) {
+        fprintf(stderr, "Could not write %s\n", output);
+        return 1;
+    }
+    printf("Wrote %s: %zu assets\n", output, assets.size());
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+// Compact 12-byte vertex format for meshes with known bounds.
+//
+// Positions are quantized to 16-bit integers relative to the mesh's bounding
+// box and decoded in the vertex shader as aPos * positionScale + positionOffset.
+// Texture coordinates are stored as half floats. The attributes are read as
+// plain (non-normalized) shorts so decoding does not depend on which SNORM
+// conversion rule the driver uses; the 1/32767 lives in positionScale instead.
+
+#include "vertex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+struct PackedVertex {
+    int16_t x, y, z;    // Quantized position
+    int16_t padding;    // Keeps the UVs 4-byte aligned
+    uint16_t u, v;      // Half-float texture coordinates
+};
+
+// Decode: position = quantized * scale + offset, per axis
+struct PositionQuantization {
+    float scale[3] = { 1.0f, 1.0f, 1.0f };
+    float offset[3] = { 0.0f, 0.0f, 0.0f };
+};
+
+// IEEE 754 binary16 conversion, round to nearest even (denormals, infinities and NaN kept)
+inline uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t magnitude = bits & 0x7FFFFFFFu;
+
+    if (magnitude >= 0x7F800000u)                       // Infinity or NaN
+        return (uint16_t)(sign | 0x7C00u | (magnitude > 0x7F800000u ? 0x0200u : 0u));
+    if (magnitude >= 0x477FF000u)                       // Rounds to 65520 or more: overflow
+        return (uint16_t)(sign | 0x7C00u);
+
+    if (magnitude < 0x38800000u) {                      // Below 2^-14: half denormal or zero
+        if (magnitude < 0x33000000u)                    // Below 2^-25 rounds to zero
+            return (uint16_t)sign;
+        uint32_t mantissa = (magnitude & 0x007FFFFFu) | 0x00800000u;
+        uint32_t shift = 126u - (magnitude >> 23);
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1u);
+        uint32_t halfway = 1u << (shift - 1u);
+        if (remainder > halfway || (remainder == halfway && (half & 1u)))
+            ++half;
+        return (uint16_t)(sign | half);
+    }
+
+    // Normal: rebias the exponent from 127 to 15 and round off 13 mantissa bits
+    uint32_t half = (magnitude - 0x38000000u) >> 13;
+    uint32_t remainder = magnitude & 0x1FFFu;
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u)))
+        ++half;                                         // A carry into the exponent is still correct
+    return (uint16_t)(sign | half);
+}
+
+inline float halfToFloat(uint16_t half) {
+    uint32_t sign = (uint32_t)(half & 0x8000u) << 16;
+    uint32_t exponent = (half >> 10) & 0x1Fu;
+    uint32_t mantissa = half & 0x03FFu;
+    uint32_t bits;
+    if (exponent == 0x1Fu) {
+        bits = sign | 0x7F800000u | (mantissa << 13);
+    }
+    else if (exponent != 0) {
+        bits = sign | ((exponent + 112u) << 23) | (mantissa << 13);
+    }
+    else {
+        float denormal = (float)mantissa * (1.0f / 16777216.0f);   // mantissa * 2^-24
+        return sign ? -denormal : denormal;
+    }
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Quantize positions to the mesh's bounding box and convert UVs to half floats
+inline PositionQuantization packVertices(const Vertex* vertices, size_t count, PackedVertex* out) {
+    PositionQuantization q;
+    if (count == 0)
+        return q;
+
+    float minimum[3] = { vertices[0].x, vertices[0].y, vertices[0].z };
+    float maximum[3] = { vertices[0].x, vertices[0].y, vertices[0].z };
+    for (size_t i = 1; i < count; ++i) {
+        const float* p = &vertices[i].x;
+        for (int a = 0; a < 3; ++a) {
+            minimum[a] = std::min(minimum[a], p[a]);
+            maximum[a] = std::max(maximum[a], p[a]);
+        }
+    }
+
+    float invScale[3];
+    for (int a = 0; a < 3; ++a) {
+        float halfExtent = (maximum[a] - minimum[a]) * 0.5f;
+        q.offset[a] = (minimum[a] + maximum[a]) * 0.5f;
+        q.scale[a] = halfExtent > 0.0f ? halfExtent / 32767.0f : 1.0f;
+        invScale[a] = 1.0f / q.scale[a];
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        const float* p = &vertices[i].x;
+        int16_t* packed = &out[i].x;
+        for (int a = 0; a < 3; ++a) {
+            float quantized = std::round((p[a] - q.offset[a]) * invScale[a]);
+            packed[a] = (int16_t)std::max(-32767.0f, std::min(32767.0f, quantized));
+        }
+        out[i].padding = 0;
+        out[i].u = floatToHalf(vertices[i].u);
+        out[i].v = floatToHalf(vertices[i].v);
+    }
+    return q;
+}
+
+// What the vertex shader reconstructs from a packed vertex
+inline Vertex unpackVertex(const PackedVertex& packed, const PositionQuantization& q) {
+    return { packed.x * q.scale[0] + q.offset[0], packed.y * q.scale[1] + q.offset[1],
+             packed.z * q.scale[2] + q.offset[2], halfToFloat(packed.u), halfToFloat(packed.v) };
+}
+
+// Difference between packed and full-precision vertices
+struct PackingError {
+    double maxPosition = 0.0, rmsPosition = 0.0;    // Euclidean distance, model units
+    double maxUV = 0.0;                             // Largest per-component UV difference
+    double boundsDiagonal = 0.0;
+};
+
+inline PackingError measurePackingError(const Vertex* vertices, const PackedVertex* packed, size_t count,
+                                        const PositionQuantization& q) {
+    PackingError error;
+    double sumSquares = 0.0;
+    float minimum[3] = { INFINITY, INFINITY, INFINITY }, maximum[3] = { -INFINITY, -INFINITY, -INFINITY };
+    for (size_t i = 0; i < count; ++i) {
+        const float* p = &vertices[i].x;
+        for (int a = 0; a < 3; ++a) {
+            minimum[a] = std::min(minimum[a], p[a]);
+            maximum[a] = std::max(maximum[a], p[a]);
+        }
+
+        Vertex decoded = unpackVertex(packed[i], q);
+        double dx = decoded.x - vertices[i].x, dy = decoded.y - vertices[i].y, dz = decoded.z - vertices[i].z;
+        double squared = dx * dx + dy * dy + dz * dz;
+        sumSquares += squared;
+        error.maxPosition = std::max(error.maxPosition, std::sqrt(squared));
+        error.maxUV = std::max(error.maxUV, (double)std::fabs(decoded.u - vertices[i].u));
+        error.maxUV = std::max(error.maxUV, (double)std::fabs(decoded.v - vertices[i].v));
+    }
+    error.rmsPosition = count ? std::sqrt(sumSquares / count) : 0.0;
+    if (count) {
+        double ex = maximum[0] - minimum[0], ey = maximum[1] - minimum[1], ez = maximum[2] - minimum[2];
+        error.boundsDiagonal = std::sqrt(ex * ex + ey * ey + ez * ez);
+    }
+    return error;
+}
+
+inline void printPackingError(const char* label, const PackingError& error, size_t count) {
+    printf("%s: %zu -> %zu bytes, position error max %.3g (%.4f%% of bounds) rms %.3g, "
+           "UV error max %.3g (%.2f texels at 1024)\n",
+           label, count * sizeof(Vertex), count * sizeof(PackedVertex), error.maxPosition,
+           error.boundsDiagonal > 0.0 ? 100.0 * error.maxPosition / error.boundsDiagonal : 0.0,
+           error.rmsPosition, error.maxUV, error.maxUV * 1024.0);
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+// Minimal PNG encoder for the images dumped by headless runs (headless.h).
+//
+// 8-bit RGBA only, every row with filter type 0 and the zlib stream made of
+// stored (uncompressed) deflate blocks. Files are larger than a real encoder's
+// but the output depends on nothing but the pixels, so identical frames give
+// byte-identical files and golden images can be compared with cmp or a hash.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// CRC-32 as used by PNG chunks (polynomial 0xEDB88320), continued from crc
+inline uint32_t pngCrc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+    static uint32_t table[256];
+    static bool tableReady = false;
+    if (!tableReady) {
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+        tableReady = true;
+    }
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+inline void pngPutU32(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back((uint8_t)(value >> 24));
+    out.push_back((uint8_t)(value >> 16));
+    out.push_back((uint8_t)(value >> 8));
+    out.push_back((uint8_t)value);
+}
+
+inline void pngPutChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data) {
+    pngPutU32(out, (uint32_t)data.size());
+    size_t typeStart = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    pngPutU32(out, pngCrc32(out.data() + typeStart, out.size() - typeStart));
+}
+
+// Write width x height RGBA pixels, rows top to bottom, to path; false on I/O errors
+inline bool writePng(const char* path, int width, int height, const uint8_t* rgba) {
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    std::vector<uint8_t> file(signature, signature + 8);
+
+    std::vector<uint8_t> header;
+    pngPutU32(header, (uint32_t)width);
+    pngPutU32(header, (uint32_t)height);
+    header.insert(header.end(), { 8, 6, 0, 0, 0 });     // 8 bits, RGBA, deflate, adaptive filtering, no interlace
+    pngPutChunk(file, "IHDR", header);
+
+    // Filtered image: a 0 (no filter) byte in front of each row
+    size_t rowBytes = (size_t)width * 4;
+    std::vector<uint8_t> raw;
+    raw.reserve((rowBytes + 1) * height);
+    for (int y = 0; y < height; ++y) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgba + y * rowBytes, rgba + (y + 1) * rowBytes);
+    }
+
+    // zlib stream: header, stored blocks of at most 65535 bytes, Adler-32 of the raw data
+    std::vector<uint8_t> zlib = { 0x78, 0x01 };
+    zlib.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    size_t offset = 0;
+    do {
+        size_t size = std::min<size_t>(raw.size() - offset, 65535);
+        bool last = offset + size == raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back((uint8_t)size);
+        zlib.push_back((uint8_t)(size >> 8));
+        zlib.push_back((uint8_t)~size);
+        zlib.push_back((uint8_t)(~size >> 8));
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + size);
+        offset += size;
+    } while (offset < raw.size());
+    uint32_t a = 1, b = 0;
+    for (uint8_t byte : raw) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    pngPutU32(zlib, (b << 16) | a);
+    pngPutChunk(file, "IDAT", zlib);
+    pngPutChunk(file, "IEND", {});
+
+    FILE* out = fopen(path, "wb");
+    if (!out)
+        return false;
+    bool written = fwrite(file.data(), 1, file.size(), out) == file.size();
+    return fclose(out) == 0 && written;
+}
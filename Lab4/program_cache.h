@@ -0,0 +1,145 @@
+#pragma once
+
+// On-disk cache of linked program binaries (GL_ARB_get_program_binary, core
+// in GL 4.1). ShaderProgram::build looks for a binary under a hash of the two
+// shader sources plus the GL vendor, renderer and version strings, so editing
+// a shader or updating the driver simply misses the cache. glProgramBinary may
+// still reject a binary (drivers are free to); the caller then compiles and
+// links as usual and stores a fresh one.
+//
+// File layout: ProgramBinaryHeader, then header.size bytes from glGetProgramBinary.
+// Files are written to a temporary name unique to the process and renamed
+// into place, so two demos starting at once never read a half-written binary.
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+const char PROGRAM_BINARY_MAGIC[4] = { 'G', 'L', 'P', 'B' };
+const uint32_t PROGRAM_BINARY_VERSION = 1;
+
+struct ProgramBinaryHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;           // programCacheKey, guards against renamed or truncated files
+    uint32_t format;        // binaryFormat from glGetProgramBinary
+    uint32_t size;
+};
+
+// True if the context can hand out program binaries at all
+inline bool programBinarySupported() {
+    GLint formats = 0;
+#ifdef GL_NUM_PROGRAM_BINARY_FORMATS
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    glGetError();   // GL_INVALID_ENUM on contexts without the extension
+#endif
+    return formats > 0;
+}
+
+// 64-bit FNV-1a over the sources and the driver identification strings
+inline uint64_t programCacheKey(const char* vertexSource, const char* fragmentSource) {
+    uint64_t h = 14695981039346656037ull;
+    auto mix = [&h](const char* text) {
+        for (const char* c = text ? text : ""; *c; ++c)
+            h = (h ^ (unsigned char)*c) * 1099511628211ull;
+        h = (h ^ 0xFF) * 1099511628211ull;   // Separator, so "ab"+"c" differs from "a"+"bc"
+    };
+    mix(vertexSource);
+    mix(fragmentSource);
+    mix(reinterpret_cast<const char*>(glGetString(GL_VENDOR)));
+    mix(reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+    mix(reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+    return h;
+}
+
+inline std::string programCachePath(const char* directory, uint64_t key) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.glbin", (unsigned long long)key);
+    return (std::filesystem::path(directory) / name).string();
+}
+
+// Load a cached binary into program. True only if the file matched key and the driver linked it.
+inline bool loadProgramBinary(GLuint program, const std::string& path, uint64_t key) {
+#ifdef GL_NUM_PROGRAM_BINARY_FORMATS
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+    ProgramBinaryHeader header;
+    std::vector<char> binary;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+              memcmp(header.magic, PROGRAM_BINARY_MAGIC, 4) == 0 && header.version == PROGRAM_BINARY_VERSION &&
+              header.key == key && header.size > 0;
+    if (ok) {
+        binary.resize(header.size);
+        ok = fread(binary.data(), 1, binary.size(), file) == binary.size();
+    }
+    fclose(file);
+    if (!ok)
+        return false;
+
+    glProgramBinary(program, (GLenum)header.format, binary.data(), (GLsizei)binary.size());
+    GLint success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    return success != 0;
+#else
+    (void)program, (void)path, (void)key;
+    return false;
+#endif
+}
+
+// Store the binary of a linked program (linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set)
+inline bool saveProgramBinary(GLuint program, const std::string& path, uint64_t key) {
+#ifdef GL_NUM_PROGRAM_BINARY_FORMATS
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return false;
+    std::vector<char> binary((size_t)length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    ProgramBinaryHeader header;
+    memcpy(header.magic, PROGRAM_BINARY_MAGIC, 4);
+    header.version = PROGRAM_BINARY_VERSION;
+    header.key = key;
+    header.format = format;
+    header.size = (uint32_t)length;
+
+    std::error_code error;
+    std::filesystem::path target(path);
+    std::filesystem::create_directories(target.parent_path(), error);
+#ifdef _WIN32
+    std::string temporary = path + "." + std::to_string(_getpid()) + ".tmp";
+#else
+    std::string temporary = path + "." + std::to_string(getpid()) + ".tmp";
+#endif
+    FILE* file = fopen(temporary.c_str(), "wb");
+    if (!file)
+        return false;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(binary.data(), 1, (size_t)length, file) == (size_t)length;
+    ok = fclose(file) == 0 && ok;
+    if (ok)
+        std::filesystem::rename(temporary, target, error);
+    if (!ok || error) {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+#else
+    (void)program, (void)path, (void)key;
+    return false;
+#endif
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+// Render on demand for the Lab4 demos (default; --continuous turns it off).
+//
+// The scenes are static once set up, so redrawing them as fast as possible
+// only keeps a core busy. RedrawScheduler marks the frame dirty on the events
+// that can change what is on screen (resize, expose, key presses, or
+// markDirty() for anything the demo changes itself) and waitForFrame blocks
+// in glfwWaitEvents until one arrives. Work finishing off the GL thread, such
+// as texture decodes, calls markDirtyWithin so a timed wait picks it up. In
+// continuous mode every frame is due immediately, as before, for
+// benchmarking. Either way the report gives the process CPU time over the
+// loop as a share of one core.
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <cstdio>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// User + system CPU time of the whole process (all threads), in seconds
+inline double processCpuSeconds() {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+        return 0.0;
+    auto seconds = [](const FILETIME& t) {
+        return (((unsigned long long)t.dwHighDateTime << 32) | t.dwLowDateTime) * 1e-7;   // 100 ns ticks
+    };
+    return seconds(kernel) + seconds(user);
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0.0;
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+}
+
+class RedrawScheduler {
+public:
+    // Take over the window's framebuffer size, refresh and key callbacks (and its user pointer).
+    // Without a window (headless) every frame is due.
+    void attach(GLFWwindow* window, bool continuous) {
+        this->window = window;
+        this->continuous = continuous;
+        if (window) {
+            glfwGetFramebufferSize(window, &width, &height);
+            glfwSetWindowUserPointer(window, this);
+            glfwSetFramebufferSizeCallback(window, onFramebufferSize);
+            glfwSetWindowRefreshCallback(window, onRefresh);
+            glfwSetKeyCallback(window, onKey);
+        }
+        startWall = Clock::now();
+        startCpu = processCpuSeconds();
+    }
+
+    void markDirty() { dirty = true; }
+
+    // Draw again within seconds even if no event arrives
+    void markDirtyWithin(double seconds) {
+        auto due = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+        if (!deadlineSet || due < deadline)
+            deadline = due;
+        deadlineSet = true;
+    }
+
+    // Block until the next frame should be drawn; false once the window is closing
+    bool waitForFrame() {
+        if (window) {
+            while (!continuous && !dirty && !glfwWindowShouldClose(window)) {
+                if (deadlineSet) {
+                    std::chrono::duration<double> remaining = deadline - Clock::now();
+                    if (remaining.count() <= 0.0)
+                        break;
+                    glfwWaitEventsTimeout(remaining.count());
+                }
+                else {
+                    glfwWaitEvents();
+                }
+                ++wakeups;
+            }
+            if (glfwWindowShouldClose(window))
+                return false;
+        }
+        dirty = false;
+        deadlineSet = false;
+        ++frames;
+        return true;
+    }
+
+    // Framebuffer size in pixels, following resizes
+    void framebufferSize(int& width, int& height) const {
+        if (window) {
+            width = this->width;
+            height = this->height;
+        }
+    }
+
+    void printReport(const char* label) const {
+        std::chrono::duration<double> wall = Clock::now() - startWall;
+        double cpu = processCpuSeconds() - startCpu;
+        printf("%s: %s, %zu frames drawn, %zu event wakeups, %.2f s CPU in %.2f s (%.1f%% of one core)\n", label,
+               continuous ? "continuous" : "on demand", frames, wakeups, cpu, wall.count(),
+               wall.count() > 0.0 ? 100.0 * cpu / wall.count() : 0.0);
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static RedrawScheduler& of(GLFWwindow* window) {
+        return *static_cast<RedrawScheduler*>(glfwGetWindowUserPointer(window));
+    }
+
+    static void onFramebufferSize(GLFWwindow* window, int width, int height) {
+        RedrawScheduler& scheduler = of(window);
+        scheduler.width = width;
+        scheduler.height = height;
+        scheduler.dirty = true;
+        glViewport(0, 0, width, height);
+    }
+
+    static void onRefresh(GLFWwindow* window) { of(window).dirty = true; }
+
+    static void onKey(GLFWwindow* window, int key, int, int action, int) {
+        if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
+            glfwSetWindowShouldClose(window, GLFW_TRUE);
+        of(window).dirty = true;
+    }
+
+    GLFWwindow* window = nullptr;
+    bool continuous = true;
+    bool dirty = true;          // The first frame is always drawn
+    int width = 0, height = 0;
+    size_t frames = 0;
+    size_t wakeups = 0;
+    bool deadlineSet = false;
+    Clock::time_point deadline;
+    Clock::time_point startWall;
+    double startCpu = 0.0;
+};
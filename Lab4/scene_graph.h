@@ -0,0 +1,94 @@
+#pragma once
+
+// Transform hierarchy for scenes of many objects.
+//
+// Nodes live in flat parallel arrays (local matrix, world matrix, parent
+// index, dirty flag) rather than as linked objects. A node can only be added
+// after its parent, so parents always precede their children. One forward
+// pass then recomputes world transforms: a node is dirty if it was changed or
+// its parent was dirty in this pass, and dirty nodes get
+// world = parent world * local. The pass starts at the first changed node and
+// touches nothing but a byte per clean node, so changing a few leaves costs
+// little more than their own matrices. The multiplies are the SIMD kernels
+// of math3d.h.
+//
+// Matrices use the demos' layout, so world(i) can be passed to
+// glUniformMatrix4fv or copied into InstanceData::model as is.
+
+#include "math3d.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+class SceneGraph {
+public:
+    static const uint32_t kNoParent = 0xFFFFFFFFu;
+
+    void reserve(size_t count) {
+        locals.reserve(count);
+        worlds.reserve(count);
+        parents.reserve(count);
+        dirty.reserve(count);
+    }
+
+    // Append a node under parent (an existing node, or kNoParent for a root) and return its index.
+    // Its world matrix is valid after the next updateWorldTransforms.
+    uint32_t addNode(uint32_t parent, const Mat4& local) {
+        uint32_t node = (uint32_t)locals.size();
+        locals.push_back(local);
+        worlds.push_back(local);
+        parents.push_back(parent);
+        dirty.push_back(1);
+        firstDirty = std::min(firstDirty, (size_t)node);
+        return node;
+    }
+
+    void setLocal(uint32_t node, const Mat4& local) {
+        locals[node] = local;
+        dirty[node] = 1;
+        firstDirty = std::min(firstDirty, (size_t)node);
+    }
+
+    const Mat4& local(uint32_t node) const { return locals[node]; }
+    const Mat4& world(uint32_t node) const { return worlds[node]; }
+    uint32_t parent(uint32_t node) const { return parents[node]; }
+    size_t size() const { return locals.size(); }
+
+    // All world matrices in node order, e.g. to upload as instance data
+    const Mat4* worldMatrices() const { return worlds.data(); }
+
+    // Bring the world matrices of changed nodes and their descendants up to date; returns how many were recomputed
+    size_t updateWorldTransforms() {
+        size_t count = locals.size();
+        if (firstDirty >= count)
+            return 0;
+
+        size_t updated = 0;
+        const uint32_t* parent = parents.data();
+        uint8_t* flags = dirty.data();
+        for (size_t i = firstDirty; i < count; ++i) {
+            uint32_t p = parent[i];
+            uint8_t changed = flags[i] | (p != kNoParent ? flags[p] : 0);
+            flags[i] = changed;     // Read by this node's children further on
+            if (!changed)
+                continue;
+            if (p == kNoParent)
+                worlds[i] = locals[i];
+            else
+                multiplyMatrices(locals[i], worlds[p], worlds[i]);
+            ++updated;
+        }
+        memset(flags + firstDirty, 0, count - firstDirty);
+        firstDirty = count;
+        return updated;
+    }
+
+private:
+    std::vector<Mat4> locals;
+    std::vector<Mat4> worlds;
+    std::vector<uint32_t> parents;
+    std::vector<uint8_t> dirty;     // Changed since the last update (during a pass: changed or under a change)
+    size_t firstDirty = 0;          // No dirty node before this index
+};
@@ -0,0 +1,342 @@
+#pragma once
+
+// Compiled and linked GLSL program with reflected uniforms and attributes.
+//
+// build() compiles, links and then asks GL for every active uniform and
+// attribute once, storing their locations in a flat open-addressing table
+// keyed by a hash of the name. Render loops resolve a uniform to a handle
+// (a table index) once, or look it up by name, which costs a hash and
+// usually a single probe instead of a driver call. The typed setters keep the
+// last value uploaded to each uniform and skip the glUniform call when it has
+// not changed, so per-frame code can set everything unconditionally.
+//
+// Given a cache directory, build() first tries a stored program binary
+// (program_cache.h) and only compiles and links when there is none or the
+// driver rejects it. buildStats() splits the startup cost into compile, link
+// and cache time.
+//
+// Setters act on the current program: call use() first. Like TextureCache,
+// the destructor makes no GL calls; call destroy() while the context exists.
+
+#include <glad/glad.h>
+#include "math3d.h"
+#include "program_cache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Issued and skipped glUniform calls, for the end-of-run report
+struct UniformStats {
+    size_t uploads = 0;
+    size_t redundant = 0;
+};
+
+// Where build() spent its time; cacheMs is the binary load on a hit, the store on a miss
+struct ShaderBuildStats {
+    double compileMs = 0.0;
+    double linkMs = 0.0;
+    double cacheMs = 0.0;
+    bool fromCache = false;
+    bool stored = false;
+};
+
+class ShaderProgram {
+public:
+    ShaderProgram() = default;
+    ShaderProgram(const ShaderProgram&) = delete;
+    ShaderProgram& operator=(const ShaderProgram&) = delete;
+
+    // Compile both stages, link and reflect. Errors go to stderr; false if the program is unusable.
+    // With cacheDirectory, a cached binary replaces compile and link, and a fresh link is stored.
+    bool build(const char* vertexSource, const char* fragmentSource, const char* cacheDirectory = nullptr) {
+        destroy();
+        buildTimes = ShaderBuildStats();
+
+        bool useCache = cacheDirectory && programBinarySupported();
+        uint64_t key = 0;
+        std::string cachePath;
+        if (useCache) {
+            auto start = Clock::now();
+            key = programCacheKey(vertexSource, fragmentSource);
+            cachePath = programCachePath(cacheDirectory, key);
+            program = glCreateProgram();
+            buildTimes.fromCache = loadProgramBinary(program, cachePath, key);
+            buildTimes.cacheMs = millisecondsSince(start);
+            if (buildTimes.fromCache) {
+                reflect();
+                return true;
+            }
+            glDeleteProgram(program);   // Missing, stale or rejected: build from source
+        }
+
+        auto start = Clock::now();
+        GLuint vertexShader = compileStage(GL_VERTEX_SHADER, vertexSource, "VERTEX_SHADER");
+        GLuint fragmentShader = compileStage(GL_FRAGMENT_SHADER, fragmentSource, "FRAGMENT_SHADER");
+        buildTimes.compileMs = millisecondsSince(start);
+
+        // Link shaders into program
+        start = Clock::now();
+        program = glCreateProgram();
+        glAttachShader(program, vertexShader);
+        glAttachShader(program, fragmentShader);
+#ifdef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+        if (useCache)
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
+        glLinkProgram(program);
+
+        // Delete shaders after linking
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+
+        int success;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        buildTimes.linkMs = millisecondsSince(start);
+        if (!success) {
+            char infoLog[512];
+            glGetProgramInfoLog(program, 512, NULL, infoLog);
+            std::cerr << "ERROR::SHADER_PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+            return false;
+        }
+
+        if (useCache) {
+            start = Clock::now();
+            buildTimes.stored = saveProgramBinary(program, cachePath, key);
+            buildTimes.cacheMs += millisecondsSince(start);
+        }
+        reflect();
+        return true;
+    }
+
+    void destroy() {
+        if (program)
+            glDeleteProgram(program);
+        program = 0;
+        uniforms.clear();
+        attributes.clear();
+        counters = UniformStats();
+    }
+
+    void use() const { glUseProgram(program); }
+    GLuint id() const { return program; }
+
+    // Handle for a uniform, or -1 if the program has no active uniform of that name.
+    // Array elements are listed individually ("textures[2]"); the bare name is element 0.
+    int uniform(const char* name) const {
+        int handle = find(uniforms, name);
+        if (handle < 0 && !strchr(name, '['))
+            handle = find(uniforms, (std::string(name) + "[0]").c_str());
+        return handle;
+    }
+
+    // Reflected location, -1 if the uniform or attribute is not active
+    GLint uniformLocation(const char* name) const {
+        int handle = uniform(name);
+        return handle < 0 ? -1 : uniforms[handle].location;
+    }
+
+    GLint attributeLocation(const char* name) const {
+        int handle = find(attributes, name);
+        return handle < 0 ? -1 : attributes[handle].location;
+    }
+
+    // Typed setters: handle or name, no-ops for inactive uniforms (as glUniform is for -1)
+    void setInt(int handle, int value) {
+        if (changed(handle, &value, sizeof(value)))
+            glUniform1i(uniforms[handle].location, value);
+    }
+
+    void setFloat(int handle, float value) {
+        if (changed(handle, &value, sizeof(value)))
+            glUniform1f(uniforms[handle].location, value);
+    }
+
+    void setVec3(int handle, const float* value) {
+        if (changed(handle, value, 3 * sizeof(float)))
+            glUniform3fv(uniforms[handle].location, 1, value);
+    }
+
+    void setMat4(int handle, const Mat4& value) {
+        if (changed(handle, value.m, sizeof(value.m)))
+            glUniformMatrix4fv(uniforms[handle].location, 1, GL_FALSE, value.m);
+    }
+
+    void setInt(const char* name, int value) { setInt(uniform(name), value); }
+    void setFloat(const char* name, float value) { setFloat(uniform(name), value); }
+    void setVec3(const char* name, const float* value) { setVec3(uniform(name), value); }
+    void setMat4(const char* name, const Mat4& value) { setMat4(uniform(name), value); }
+
+    const UniformStats& stats() const { return counters; }
+    const ShaderBuildStats& buildStats() const { return buildTimes; }
+
+    void printBuildReport(const char* label) const {
+        if (buildTimes.fromCache)
+            printf("%s: program binary loaded from cache in %.2f ms (compile and link skipped)\n", label,
+                   buildTimes.cacheMs);
+        else
+            printf("%s: compile %.2f ms, link %.2f ms, cache %.2f ms (%s)\n", label, buildTimes.compileMs,
+                   buildTimes.linkMs, buildTimes.cacheMs, buildTimes.stored ? "binary stored" : "not cached");
+    }
+
+    void printReport(const char* label) const {
+        size_t total = counters.uploads + counters.redundant;
+        printf("%s: %zu uniforms, %zu attributes; %zu glUniform calls, %zu redundant skipped (%.1f%%)\n", label,
+               activeUniforms, activeAttributes, counters.uploads, counters.redundant,
+               total ? 100.0 * counters.redundant / total : 0.0);
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static double millisecondsSince(Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    // One table slot; name is empty when the slot is free
+    struct Slot {
+        std::string name;
+        uint32_t hash = 0;
+        GLint location = -1;
+        GLenum type = 0;
+        bool hasValue = false;
+        unsigned char value[sizeof(Mat4::m)];   // Last upload; large enough for a mat4
+    };
+
+    // FNV-1a, the same mixing as hashVertex in mesh_opt.h
+    static uint32_t hashName(const char* name) {
+        uint32_t h = 2166136261u;
+        for (; *name; ++name)
+            h = (h ^ (unsigned char)*name) * 16777619u;
+        return h;
+    }
+
+    static int find(const std::vector<Slot>& table, const char* name) {
+        if (table.empty())
+            return -1;
+        uint32_t hash = hashName(name);
+        size_t mask = table.size() - 1;
+        for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+            if (table[slot].name.empty())
+                return -1;
+            if (table[slot].hash == hash && table[slot].name == name)
+                return (int)slot;
+        }
+    }
+
+    static void insert(std::vector<Slot>& table, const std::string& name, GLint location, GLenum type) {
+        uint32_t hash = hashName(name.c_str());
+        size_t mask = table.size() - 1;
+        size_t slot = hash & mask;
+        while (!table[slot].name.empty()) {
+            if (table[slot].name == name)
+                return;
+            slot = (slot + 1) & mask;
+        }
+        table[slot].name = name;
+        table[slot].hash = hash;
+        table[slot].location = location;
+        table[slot].type = type;
+    }
+
+    // Table with room for count names at most half full
+    static std::vector<Slot> makeTable(size_t count) {
+        size_t size = 8;
+        while (size < count * 2)
+            size *= 2;
+        return std::vector<Slot>(size);
+    }
+
+    static GLuint compileStage(GLenum stage, const char* source, const char* label) {
+        GLuint shader = glCreateShader(stage);
+        glShaderSource(shader, 1, &source, NULL);
+        glCompileShader(shader);
+
+        // Check for compilation errors
+        int success;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+        if (!success) {
+            char infoLog[512];
+            glGetShaderInfoLog(shader, 512, NULL, infoLog);
+            std::cerr << "ERROR::" << label << "::COMPILATION_FAILED\n" << infoLog << std::endl;
+        }
+        return shader;
+    }
+
+    void reflect() {
+        GLint uniformCount = 0, attributeCount = 0, maxLength = 0, maxAttributeLength = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniformCount);
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &attributeCount);
+        glGetProgramiv(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxAttributeLength);
+        std::vector<char> buffer((size_t)std::max(maxLength, maxAttributeLength) + 1);
+
+        // Arrays report one uniform ("textures[0]", size 5); list every element
+        struct Reflected {
+            std::string name;
+            GLint size;
+            GLenum type;
+        };
+        std::vector<Reflected> reflected;
+        size_t elementCount = 0;
+        for (GLint i = 0; i < uniformCount; ++i) {
+            GLint size;
+            GLenum type;
+            glGetActiveUniform(program, (GLuint)i, (GLsizei)buffer.size(), nullptr, &size, &type, buffer.data());
+            reflected.push_back({ buffer.data(), size, type });
+            elementCount += (size_t)size;
+        }
+
+        uniforms = makeTable(elementCount);
+        for (const Reflected& entry : reflected) {
+            std::string base = entry.name;
+            size_t bracket = base.find('[');
+            if (bracket != std::string::npos)
+                base.resize(bracket);
+            if (entry.size == 1 && bracket == std::string::npos) {
+                insert(uniforms, base, glGetUniformLocation(program, base.c_str()), entry.type);
+                continue;
+            }
+            for (GLint element = 0; element < entry.size; ++element) {
+                std::string name = base + "[" + std::to_string(element) + "]";
+                insert(uniforms, name, glGetUniformLocation(program, name.c_str()), entry.type);
+            }
+        }
+        activeUniforms = (size_t)uniformCount;
+
+        attributes = makeTable((size_t)attributeCount);
+        for (GLint i = 0; i < attributeCount; ++i) {
+            GLint size;
+            GLenum type;
+            glGetActiveAttrib(program, (GLuint)i, (GLsizei)buffer.size(), nullptr, &size, &type, buffer.data());
+            insert(attributes, buffer.data(), glGetAttribLocation(program, buffer.data()), type);
+        }
+        activeAttributes = (size_t)attributeCount;
+    }
+
+    // Record value for handle; false if the uniform is inactive or already holds it
+    bool changed(int handle, const void* value, size_t size) {
+        if (handle < 0)
+            return false;
+        Slot& slot = uniforms[handle];
+        if (slot.hasValue && memcmp(slot.value, value, size) == 0) {
+            ++counters.redundant;
+            return false;
+        }
+        memcpy(slot.value, value, size);
+        slot.hasValue = true;
+        ++counters.uploads;
+        return true;
+    }
+
+    GLuint program = 0;
+    std::vector<Slot> uniforms, attributes;
+    size_t activeUniforms = 0, activeAttributes = 0;
+    UniformStats counters;
+    ShaderBuildStats buildTimes;
+};
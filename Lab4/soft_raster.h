@@ -0,0 +1,534 @@
+#pragma once
+
+// CPU software rasterizer for the Lab4 demos.
+//
+// Takes the same Vertex arrays and index buffers as the glDrawElements path,
+// bins the triangles into screen tiles and shades the tiles in parallel on all
+// cores. Matches the GLSL shaders: gl_Position = mvp * vec4(aPos, 1.0), depth
+// test GL_LESS, perspective-correct texture coordinates and trilinear
+// (GL_LINEAR_MIPMAP_LINEAR) sampling with GL_REPEAT wrapping.
+
+#include <glad/glad.h>
+#include "stb_image.h"
+#include "math3d.h"
+#include "thread_pool.h"
+#include "vertex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// CPU copy of a texture, RGBA8 with a full mip chain (rows bottom-up like GL)
+struct SoftTexture {
+    struct Level {
+        int width = 0, height = 0;
+        std::vector<uint32_t> texels;
+    };
+    std::vector<Level> levels;
+};
+
+// Build the mip chain of a texture from its base level (2x2 box filter)
+inline void buildSoftMipmaps(SoftTexture& texture) {
+    texture.levels.resize(1);
+    while (texture.levels.back().width > 1 || texture.levels.back().height > 1) {
+        const SoftTexture::Level& src = texture.levels.back();
+        SoftTexture::Level dst;
+        dst.width = std::max(1, src.width / 2);
+        dst.height = std::max(1, src.height / 2);
+        dst.texels.resize((size_t)dst.width * dst.height);
+
+        for (int y = 0; y < dst.height; ++y) {
+            int y0 = std::min(y * 2, src.height - 1);
+            int y1 = std::min(y * 2 + 1, src.height - 1);
+            for (int x = 0; x < dst.width; ++x) {
+                int x0 = std::min(x * 2, src.width - 1);
+                int x1 = std::min(x * 2 + 1, src.width - 1);
+                uint32_t t[4] = {
+                    src.texels[(size_t)y0 * src.width + x0], src.texels[(size_t)y0 * src.width + x1],
+                    src.texels[(size_t)y1 * src.width + x0], src.texels[(size_t)y1 * src.width + x1]
+                };
+                uint32_t result = 0;
+                for (int c = 0; c < 4; ++c) {
+                    uint32_t sum = 0;
+                    for (int k = 0; k < 4; ++k)
+                        sum += (t[k] >> (c * 8)) & 0xFF;
+                    result |= ((sum + 2) / 4) << (c * 8);
+                }
+                dst.texels[(size_t)y * dst.width + x] = result;
+            }
+        }
+        texture.levels.push_back(std::move(dst));
+    }
+}
+
+// Load a texture from file into CPU memory (same orientation as loadTexture)
+inline SoftTexture loadSoftTexture(const char* path) {
+    SoftTexture texture;
+    texture.levels.resize(1);
+    SoftTexture::Level& base = texture.levels[0];
+
+    int texWidth, texHeight, nrChannels;
+    stbi_set_flip_vertically_on_load(true);
+    unsigned char* data = stbi_load(path, &texWidth, &texHeight, &nrChannels, 4);
+    if (data) {
+        base.width = texWidth;
+        base.height = texHeight;
+        base.texels.resize((size_t)texWidth * texHeight);
+        memcpy(base.texels.data(), data, base.texels.size() * sizeof(uint32_t));
+        stbi_image_free(data);
+    }
+    else {
+        // An incomplete GL texture samples as opaque black
+        std::cerr << "Failed to load texture: " << path << std::endl;
+        base.width = base.height = 1;
+        base.texels.assign(1, 0xFF000000u);
+    }
+
+    buildSoftMipmaps(texture);
+    return texture;
+}
+
+// Bilinear fetch from one mip level with GL_REPEAT wrapping
+inline void sampleSoftLevel(const SoftTexture::Level& level, float u, float v, float out[4]) {
+    float fx = u * level.width - 0.5f;
+    float fy = v * level.height - 0.5f;
+    float flx = floorf(fx), fly = floorf(fy);
+    float ax = fx - flx, ay = fy - fly;
+
+    int x0 = (int)flx % level.width;
+    int y0 = (int)fly % level.height;
+    if (x0 < 0) x0 += level.width;
+    if (y0 < 0) y0 += level.height;
+    int x1 = (x0 + 1 == level.width) ? 0 : x0 + 1;
+    int y1 = (y0 + 1 == level.height) ? 0 : y0 + 1;
+
+    const uint32_t* row0 = &level.texels[(size_t)y0 * level.width];
+    const uint32_t* row1 = &level.texels[(size_t)y1 * level.width];
+    uint32_t t00 = row0[x0], t10 = row0[x1], t01 = row1[x0], t11 = row1[x1];
+
+    float w00 = (1.0f - ax) * (1.0f - ay), w10 = ax * (1.0f - ay);
+    float w01 = (1.0f - ax) * ay, w11 = ax * ay;
+    for (int c = 0; c < 4; ++c) {
+        int s = c * 8;
+        out[c] = w00 * ((t00 >> s) & 0xFF) + w10 * ((t10 >> s) & 0xFF) +
+                 w01 * ((t01 >> s) & 0xFF) + w11 * ((t11 >> s) & 0xFF);
+    }
+}
+
+// Trilinear sample, lod = log2 of the texel footprint of one pixel
+inline uint32_t sampleSoftTexture(const SoftTexture& texture, float u, float v, float lod) {
+    float color[4];
+    int maxLevel = (int)texture.levels.size() - 1;
+    if (lod <= 0.0f || maxLevel == 0) {
+        sampleSoftLevel(texture.levels[0], u, v, color); // Magnification
+    }
+    else {
+        if (lod > (float)maxLevel) lod = (float)maxLevel;
+        int l0 = (int)lod;
+        int l1 = std::min(l0 + 1, maxLevel);
+        float t = lod - (float)l0;
+
+        float c1[4];
+        sampleSoftLevel(texture.levels[l0], u, v, color);
+        sampleSoftLevel(texture.levels[l1], u, v, c1);
+        for (int c = 0; c < 4; ++c)
+            color[c] += (c1[c] - color[c]) * t;
+    }
+
+    uint32_t result = 0;
+    for (int c = 0; c < 4; ++c)
+        result |= (uint32_t)(color[c] + 0.5f) << (c * 8);
+    return result;
+}
+
+// Color (RGBA8) and depth targets, row 0 at the bottom like the GL framebuffer
+struct SoftFramebuffer {
+    int width = 0, height = 0;
+    std::vector<uint32_t> color;
+    std::vector<float> depth;
+};
+
+// Tile-binned rasterizer: record draws, then finish() transforms, bins and shades them
+class SoftRasterizer {
+public:
+    static const int TILE_SIZE = 64;
+
+    explicit SoftRasterizer(unsigned threadCount = 0) : pool(threadCount) {}
+
+    // Resize the framebuffer (call when the window size changes)
+    void setViewport(int width, int height) {
+        fb.width = width;
+        fb.height = height;
+        fb.color.assign((size_t)width * height, 0);
+        fb.depth.assign((size_t)width * height, 1.0f);
+        tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+        tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    }
+
+    // Start a new frame; the clear color is applied to every tile in finish()
+    void clear(float r, float g, float b, float a) {
+        clearColor = packColor(r) | packColor(g) << 8 | packColor(b) << 16 | packColor(a) << 24;
+        draws.clear();
+    }
+
+    // Queue an indexed GL_TRIANGLES draw; the arrays must stay valid until finish().
+    // mvp is projection * view * model as the vertex shader computes it.
+    void drawElements(const Vertex* vertices, size_t vertexCount,
+                      const unsigned int* indices, size_t indexCount,
+                      const Mat4& mvp, const SoftTexture* texture) {
+        Draw draw;
+        draw.vertices = vertices;
+        draw.vertexCount = vertexCount;
+        draw.indices = indices;
+        draw.triangleCount = indexCount / 3;
+        draw.mvp = mvp;
+        draw.texture = texture;
+        draws.push_back(draw);
+    }
+
+    // Transform, bin and shade all queued draws
+    void finish() {
+        transformVertices();
+        setupAndBin();
+        shadeTiles();
+    }
+
+    const SoftFramebuffer& framebuffer() const { return fb; }
+    unsigned threadCount() const { return pool.size(); }
+
+private:
+    static constexpr size_t VERTEX_CHUNK = 4096;
+    static const size_t TRIANGLE_CHUNK = 1024;
+
+    struct Draw {
+        const Vertex* vertices;
+        size_t vertexCount;
+        const unsigned int* indices;
+        size_t triangleCount;
+        Mat4 mvp;
+        const SoftTexture* texture;
+        size_t clipOffset;      // First entry in clipPositions
+        size_t firstJob;        // First setup job of this draw
+    };
+
+    // Clip-space position plus texture coordinates
+    struct ClipVertex {
+        float x, y, z, w;
+        float u, v;
+    };
+
+    // Plane equation a*x + b*y + c over pixel centers
+    struct Plane {
+        float a, b, c;
+        float at(float x, float y) const { return a * x + b * y + c; }
+    };
+
+    // Screen-space triangle ready for scan conversion
+    struct SetupTriangle {
+        int minX, minY, maxX, maxY;     // Inclusive pixel bounds
+        Plane edge[3];
+        bool topLeft[3];
+        Plane depth, invW, uOverW, vOverW;
+        const SoftTexture* texture;
+    };
+
+    // Output of one setup job: its triangles and their per-tile bins (kept in submission order)
+    struct SetupJob {
+        size_t draw, firstTriangle, lastTriangle;
+        std::vector<SetupTriangle> triangles;
+        std::vector<std::vector<uint32_t>> bins;
+    };
+
+    static uint32_t packColor(float c) {
+        c = std::min(std::max(c, 0.0f), 1.0f);
+        return (uint32_t)(c * 255.0f + 0.5f);
+    }
+
+    void transformVertices() {
+        size_t total = 0;
+        std::vector<size_t> jobDraw, jobStart;
+        for (size_t d = 0; d < draws.size(); ++d) {
+            draws[d].clipOffset = total;
+            total += draws[d].vertexCount;
+            for (size_t s = 0; s < draws[d].vertexCount; s += VERTEX_CHUNK) {
+                jobDraw.push_back(d);
+                jobStart.push_back(s);
+            }
+        }
+        clipPositions.resize(total);
+
+        pool.run(jobDraw.size(), [&](size_t job, unsigned) {
+            const Draw& draw = draws[jobDraw[job]];
+            size_t start = jobStart[job];
+            size_t count = std::min(VERTEX_CHUNK, draw.vertexCount - start);
+            transformPositions(draw.mvp, &draw.vertices[start], sizeof(Vertex),
+                               &clipPositions[draw.clipOffset + start], count);
+        });
+    }
+
+    void setupAndBin() {
+        size_t jobCount = 0;
+        for (size_t d = 0; d < draws.size(); ++d) {
+            draws[d].firstJob = jobCount;
+            jobCount += (draws[d].triangleCount + TRIANGLE_CHUNK - 1) / TRIANGLE_CHUNK;
+        }
+
+        if (jobs.size() < jobCount)
+            jobs.resize(jobCount);
+        activeJobs = jobCount;
+        for (size_t d = 0; d < draws.size(); ++d) {
+            for (size_t t = 0, j = draws[d].firstJob; t < draws[d].triangleCount; t += TRIANGLE_CHUNK, ++j) {
+                jobs[j].draw = d;
+                jobs[j].firstTriangle = t;
+                jobs[j].lastTriangle = std::min(t + TRIANGLE_CHUNK, draws[d].triangleCount);
+            }
+        }
+
+        pool.run(jobCount, [&](size_t j, unsigned) {
+            SetupJob& job = jobs[j];
+            job.triangles.clear();
+            job.bins.resize((size_t)tilesX * tilesY);
+            for (std::vector<uint32_t>& bin : job.bins)
+                bin.clear();
+
+            const Draw& draw = draws[job.draw];
+            const Vec4* clip = &clipPositions[draw.clipOffset];
+            for (size_t t = job.firstTriangle; t < job.lastTriangle; ++t) {
+                const unsigned int* tri = &draw.indices[t * 3];
+                ClipVertex c[3];
+                for (int k = 0; k < 3; ++k) {
+                    const Vec4& p = clip[tri[k]];
+                    c[k] = { p.x, p.y, p.z, p.w, draw.vertices[tri[k]].u, draw.vertices[tri[k]].v };
+                }
+                clipAndSetup(c[0], c[1], c[2], draw.texture, job);
+            }
+        });
+    }
+
+    // Clip against the near (z >= -w) and far (z <= w) planes, then set up the fan
+    void clipAndSetup(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c,
+                      const SoftTexture* texture, SetupJob& job) const {
+        ClipVertex polyA[5] = { a, b, c };
+        ClipVertex polyB[5];
+        int count = 3;
+
+        for (int plane = 0; plane < 2; ++plane) {
+            float sign = plane == 0 ? 1.0f : -1.0f;
+            ClipVertex* in = plane == 0 ? polyA : polyB;
+            ClipVertex* out = plane == 0 ? polyB : polyA;
+            int outCount = 0;
+            for (int i = 0; i < count; ++i) {
+                const ClipVertex& p = in[i];
+                const ClipVertex& q = in[(i + 1) % count];
+                float dp = p.w + sign * p.z;
+                float dq = q.w + sign * q.z;
+                if (dp >= 0.0f)
+                    out[outCount++] = p;
+                if ((dp >= 0.0f) != (dq >= 0.0f)) {
+                    float t = dp / (dp - dq);
+                    ClipVertex& r = out[outCount++];
+                    r.x = p.x + (q.x - p.x) * t;
+                    r.y = p.y + (q.y - p.y) * t;
+                    r.z = p.z + (q.z - p.z) * t;
+                    r.w = p.w + (q.w - p.w) * t;
+                    r.u = p.u + (q.u - p.u) * t;
+                    r.v = p.v + (q.v - p.v) * t;
+                }
+            }
+            count = outCount;
+            if (count < 3)
+                return;
+        }
+
+        for (int i = 1; i + 1 < count; ++i)
+            setupTriangle(polyA[0], polyA[i], polyA[i + 1], texture, job);
+    }
+
+    void setupTriangle(const ClipVertex& c0, const ClipVertex& c1, const ClipVertex& c2,
+                       const SoftTexture* texture, SetupJob& job) const {
+        // Perspective divide and viewport transform
+        const ClipVertex* c[3] = { &c0, &c1, &c2 };
+        float sx[3], sy[3], sz[3], iw[3];
+        for (int i = 0; i < 3; ++i) {
+            iw[i] = 1.0f / c[i]->w;
+            sx[i] = (c[i]->x * iw[i] * 0.5f + 0.5f) * fb.width;
+            sy[i] = (c[i]->y * iw[i] * 0.5f + 0.5f) * fb.height;
+            sz[i] = c[i]->z * iw[i] * 0.5f + 0.5f;
+        }
+
+        float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sx[2] - sx[0]) * (sy[1] - sy[0]);
+        if (!(area != 0.0f) || !std::isfinite(area))
+            return; // Degenerate (face culling is off in the GL path, so both windings draw)
+
+        SetupTriangle tri;
+        float minXf = std::min(sx[0], std::min(sx[1], sx[2]));
+        float maxXf = std::max(sx[0], std::max(sx[1], sx[2]));
+        float minYf = std::min(sy[0], std::min(sy[1], sy[2]));
+        float maxYf = std::max(sy[0], std::max(sy[1], sy[2]));
+        tri.minX = std::max(0, (int)floorf(minXf - 0.5f));
+        tri.minY = std::max(0, (int)floorf(minYf - 0.5f));
+        tri.maxX = std::min(fb.width - 1, (int)ceilf(maxXf - 0.5f));
+        tri.maxY = std::min(fb.height - 1, (int)ceilf(maxYf - 0.5f));
+        if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+            return;
+
+        // Edge functions, oriented so the inside is positive for either winding
+        float orient = area > 0.0f ? 1.0f : -1.0f;
+        for (int e = 0; e < 3; ++e) {
+            int i = (e + 1) % 3, j = (e + 2) % 3;
+            float a = (sy[i] - sy[j]) * orient;
+            float b = (sx[j] - sx[i]) * orient;
+            tri.edge[e] = { a, b, -(a * sx[i] + b * sy[i]) };
+            tri.topLeft[e] = a > 0.0f || (a == 0.0f && b < 0.0f);
+        }
+
+        // Attribute planes from barycentric weights: f(x,y) = sum(l_i * f_i)
+        float invArea = 1.0f / (area * orient);
+        auto makePlane = [&](float f0, float f1, float f2) {
+            Plane p;
+            p.a = (tri.edge[0].a * f0 + tri.edge[1].a * f1 + tri.edge[2].a * f2) * invArea;
+            p.b = (tri.edge[0].b * f0 + tri.edge[1].b * f1 + tri.edge[2].b * f2) * invArea;
+            p.c = (tri.edge[0].c * f0 + tri.edge[1].c * f1 + tri.edge[2].c * f2) * invArea;
+            return p;
+        };
+        tri.depth = makePlane(sz[0], sz[1], sz[2]);
+        tri.invW = makePlane(iw[0], iw[1], iw[2]);
+        tri.uOverW = makePlane(c0.u * iw[0], c1.u * iw[1], c2.u * iw[2]);
+        tri.vOverW = makePlane(c0.v * iw[0], c1.v * iw[1], c2.v * iw[2]);
+        tri.texture = texture;
+
+        uint32_t index = (uint32_t)job.triangles.size();
+        job.triangles.push_back(tri);
+        for (int ty = tri.minY / TILE_SIZE; ty <= tri.maxY / TILE_SIZE; ++ty)
+            for (int tx = tri.minX / TILE_SIZE; tx <= tri.maxX / TILE_SIZE; ++tx)
+                job.bins[(size_t)ty * tilesX + tx].push_back(index);
+    }
+
+    void shadeTiles() {
+        pool.run((size_t)tilesX * tilesY, [&](size_t tile, unsigned) {
+            int x0 = (int)(tile % tilesX) * TILE_SIZE;
+            int y0 = (int)(tile / tilesX) * TILE_SIZE;
+            int x1 = std::min(x0 + TILE_SIZE, fb.width) - 1;
+            int y1 = std::min(y0 + TILE_SIZE, fb.height) - 1;
+
+            for (int y = y0; y <= y1; ++y) {
+                size_t row = (size_t)y * fb.width;
+                std::fill(&fb.color[row + x0], &fb.color[row + x1] + 1, clearColor);
+                std::fill(&fb.depth[row + x0], &fb.depth[row + x1] + 1, 1.0f);
+            }
+
+            for (size_t j = 0; j < activeJobs; ++j) {
+                const SetupJob& job = jobs[j];
+                for (uint32_t index : job.bins[tile])
+                    rasterize(job.triangles[index], x0, y0, x1, y1);
+            }
+        });
+    }
+
+    void rasterize(const SetupTriangle& tri, int tx0, int ty0, int tx1, int ty1) {
+        int minX = std::max(tri.minX, tx0), maxX = std::min(tri.maxX, tx1);
+        int minY = std::max(tri.minY, ty0), maxY = std::min(tri.maxY, ty1);
+        if (minX > maxX || minY > maxY)
+            return;
+
+        const SoftTexture* texture = tri.texture;
+        float texW = texture ? (float)texture->levels[0].width : 0.0f;
+        float texH = texture ? (float)texture->levels[0].height : 0.0f;
+
+        for (int y = minY; y <= maxY; ++y) {
+            float py = y + 0.5f;
+            float px = minX + 0.5f;
+            float e0 = tri.edge[0].at(px, py);
+            float e1 = tri.edge[1].at(px, py);
+            float e2 = tri.edge[2].at(px, py);
+            float z = tri.depth.at(px, py);
+            float iw = tri.invW.at(px, py);
+            float uw = tri.uOverW.at(px, py);
+            float vw = tri.vOverW.at(px, py);
+            size_t row = (size_t)y * fb.width;
+
+            for (int x = minX; x <= maxX; ++x) {
+                bool inside = (e0 > 0.0f || (e0 == 0.0f && tri.topLeft[0])) &&
+                              (e1 > 0.0f || (e1 == 0.0f && tri.topLeft[1])) &&
+                              (e2 > 0.0f || (e2 == 0.0f && tri.topLeft[2]));
+                if (inside && z < fb.depth[row + x]) {
+                    fb.depth[row + x] = z;
+                    uint32_t color = 0xFF000000u;
+                    if (texture) {
+                        // Perspective-correct coordinates and their screen-space derivatives
+                        float w = 1.0f / iw;
+                        float u = uw * w, v = vw * w;
+                        float dudx = (tri.uOverW.a - u * tri.invW.a) * w * texW;
+                        float dvdx = (tri.vOverW.a - v * tri.invW.a) * w * texH;
+                        float dudy = (tri.uOverW.b - u * tri.invW.b) * w * texW;
+                        float dvdy = (tri.vOverW.b - v * tri.invW.b) * w * texH;
+                        float rho2 = std::max(dudx * dudx + dvdx * dvdx, dudy * dudy + dvdy * dvdy);
+                        float lod = rho2 > 1.0f ? 0.5f * log2f(rho2) : 0.0f;
+                        color = sampleSoftTexture(*texture, u, v, lod);
+                    }
+                    fb.color[row + x] = color;
+                }
+                e0 += tri.edge[0].a;
+                e1 += tri.edge[1].a;
+                e2 += tri.edge[2].a;
+                z += tri.depth.a;
+                iw += tri.invW.a;
+                uw += tri.uOverW.a;
+                vw += tri.vOverW.a;
+            }
+        }
+    }
+
+    ThreadPool pool;
+    SoftFramebuffer fb;
+    int tilesX = 0, tilesY = 0;
+    uint32_t clearColor = 0;
+    std::vector<Draw> draws;
+    std::vector<Vec4> clipPositions;
+    std::vector<SetupJob> jobs;
+    size_t activeJobs = 0;
+};
+
+// Shows a SoftFramebuffer in the current GL context by blitting it to the framebuffer bound for
+// drawing (the window's, or the offscreen one of a headless run)
+class SoftPresenter {
+public:
+    ~SoftPresenter() {
+        if (framebufferID) glDeleteFramebuffers(1, &framebufferID);
+        if (textureID) glDeleteTextures(1, &textureID);
+    }
+
+    void present(const SoftFramebuffer& fb, int windowWidth, int windowHeight) {
+        if (!textureID) {
+            glGenTextures(1, &textureID);
+            glGenFramebuffers(1, &framebufferID);
+        }
+
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        if (fb.width != width || fb.height != height) {
+            width = fb.width;
+            height = fb.height;
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, fb.color.data());
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, framebufferID);
+            glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureID, 0);
+        }
+        else {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, fb.color.data());
+        }
+
+        GLint target = 0;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebufferID);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, windowWidth, windowHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, target);
+    }
+
+private:
+    unsigned int textureID = 0, framebufferID = 0;
+    int width = 0, height = 0;
+};
@@ -0,0 +1,190 @@
+#pragma once
+
+// Compile-time versions of the mesh generators in mesh.h for fixed-size primitives.
+//
+// Box<>, Pyramid<> and Sphere<Sectors, Stacks> expose constexpr std::array
+// vertices and indices that live in read-only data and can be handed straight
+// to glBufferData without any work at startup. Dimensions are integer ratios
+// (floats cannot be template arguments in C++17); the defaults match the demos.
+// Use the runtime functions in mesh.h for parameters only known at run time.
+
+#include "mesh.h"
+#include "vertex.h"
+
+#include <array>
+#include <cstddef>
+
+namespace static_mesh_detail {
+
+constexpr double PI = 3.14159265358979323846;
+
+// sin(x) and cos(x) for |x| <= pi/2, Taylor series to double precision
+constexpr double sinSeries(double x) {
+    double x2 = x * x;
+    double term = x, sum = x;
+    for (int n = 1; n < 14; ++n) {
+        term *= -x2 / ((2.0 * n) * (2.0 * n + 1.0));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double cosSeries(double x) {
+    double x2 = x * x;
+    double term = 1.0, sum = 1.0;
+    for (int n = 1; n < 14; ++n) {
+        term *= -x2 / ((2.0 * n - 1.0) * (2.0 * n));
+        sum += term;
+    }
+    return sum;
+}
+
+// Reduce to [-pi, pi]
+constexpr double reduceAngle(double x) {
+    double turns = x / (2.0 * PI);
+    long long n = (long long)(turns >= 0.0 ? turns + 0.5 : turns - 0.5);
+    return x - (double)n * 2.0 * PI;
+}
+
+constexpr double sinDouble(double x) {
+    x = reduceAngle(x);
+    if (x > PI / 2.0)
+        x = PI - x;
+    else if (x < -PI / 2.0)
+        x = -PI - x;
+    return sinSeries(x);
+}
+
+constexpr double cosDouble(double x) {
+    x = reduceAngle(x);
+    if (x < 0.0)
+        x = -x;
+    bool negate = x > PI / 2.0;
+    if (negate)
+        x = PI - x;
+    // Near pi/2 use the sine of the (exactly computed) distance to keep small results accurate
+    double c = x > PI / 4.0 ? sinSeries(PI / 2.0 - x) : cosSeries(x);
+    return negate ? -c : c;
+}
+
+// Evaluated in double and rounded once, so they agree with a correctly rounded sinf/cosf
+constexpr float sinConst(float x) { return (float)sinDouble((double)x); }
+constexpr float cosConst(float x) { return (float)cosDouble((double)x); }
+
+} // namespace static_mesh_detail
+
+// Compile-time createBoxVertices/createBoxIndices (the same code runs in both paths)
+constexpr std::array<Vertex, 24> makeBoxVertices(const Vertex& center, float width, float height, float depth) {
+    std::array<Vertex, 24> vertices{};
+    createBoxVertices(vertices.data(), center, width, height, depth);
+    return vertices;
+}
+
+constexpr std::array<unsigned int, 36> makeBoxIndices() {
+    std::array<unsigned int, 36> indices{};
+    createBoxIndices(indices.data());
+    return indices;
+}
+
+// Compile-time createTexturedPyramid: 18 vertices, identity index list
+constexpr std::array<Vertex, 18> makePyramidVertices(const Vertex& center, float baseSize, float pyramidHeight) {
+    float halfBase = baseSize / 2.0f;
+    float halfHeight = pyramidHeight / 2.0f;
+
+    Vertex v0 = { center.x - halfBase, center.y - halfHeight, center.z + halfBase, 0.0f, 0.0f }; // Front-left base
+    Vertex v1 = { center.x + halfBase, center.y - halfHeight, center.z + halfBase, 0.0f, 0.0f }; // Front-right base
+    Vertex v2 = { center.x + halfBase, center.y - halfHeight, center.z - halfBase, 0.0f, 0.0f }; // Back-right base
+    Vertex v3 = { center.x - halfBase, center.y - halfHeight, center.z - halfBase, 0.0f, 0.0f }; // Back-left base
+    Vertex v4 = { center.x, center.y + halfHeight, center.z, 0.0f, 0.0f };                       // Apex
+
+    // Base (two triangles), then four sides with bottom-left, bottom-right, top-center UVs
+    return {{
+        { v0.x, v0.y, v0.z, 0.0f, 0.0f }, { v1.x, v1.y, v1.z, 1.0f, 0.0f }, { v2.x, v2.y, v2.z, 1.0f, 1.0f },
+        { v2.x, v2.y, v2.z, 1.0f, 1.0f }, { v3.x, v3.y, v3.z, 0.0f, 1.0f }, { v0.x, v0.y, v0.z, 0.0f, 0.0f },
+        { v0.x, v0.y, v0.z, 0.0f, 0.0f }, { v1.x, v1.y, v1.z, 1.0f, 0.0f }, { v4.x, v4.y, v4.z, 0.5f, 1.0f },
+        { v1.x, v1.y, v1.z, 0.0f, 0.0f }, { v2.x, v2.y, v2.z, 1.0f, 0.0f }, { v4.x, v4.y, v4.z, 0.5f, 1.0f },
+        { v2.x, v2.y, v2.z, 0.0f, 0.0f }, { v3.x, v3.y, v3.z, 1.0f, 0.0f }, { v4.x, v4.y, v4.z, 0.5f, 1.0f },
+        { v3.x, v3.y, v3.z, 0.0f, 0.0f }, { v0.x, v0.y, v0.z, 1.0f, 0.0f }, { v4.x, v4.y, v4.z, 0.5f, 1.0f },
+    }};
+}
+
+constexpr std::array<unsigned int, 18> makePyramidIndices() {
+    std::array<unsigned int, 18> indices{};
+    for (unsigned int i = 0; i < 18; ++i)
+        indices[i] = i;
+    return indices;
+}
+
+// Compile-time createSphereVertices, same expressions evaluated in the same order
+template <unsigned int SectorCount, unsigned int StackCount>
+constexpr std::array<Vertex, (SectorCount + 1) * (StackCount + 1)> makeSphereVertices(float radius) {
+    using static_mesh_detail::cosConst;
+    using static_mesh_detail::sinConst;
+
+    const float PI = 3.14159265359f;
+    float sectorStep = 2 * PI / SectorCount;
+    float stackStep = PI / StackCount;
+
+    std::array<Vertex, (SectorCount + 1) * (StackCount + 1)> vertices{};
+    size_t k = 0;
+    for (unsigned int i = 0; i <= StackCount; ++i) {
+        float stackAngle = PI / 2 - i * stackStep;  // From pi/2 to -pi/2
+        float xy = radius * cosConst(stackAngle);   // r * cos(u)
+        float y = radius * sinConst(stackAngle);    // r * sin(u)
+
+        for (unsigned int j = 0; j <= SectorCount; ++j) {
+            float sectorAngle = j * sectorStep;     // From 0 to 2pi
+            vertices[k++] = { xy * cosConst(sectorAngle), y, xy * sinConst(sectorAngle),
+                              (float)j / SectorCount, (float)i / StackCount };
+        }
+    }
+    return vertices;
+}
+
+template <unsigned int SectorCount, unsigned int StackCount>
+constexpr std::array<unsigned int, (StackCount < 2 ? 0 : 6 * SectorCount * (StackCount - 1))> makeSphereIndices() {
+    std::array<unsigned int, (StackCount < 2 ? 0 : 6 * SectorCount * (StackCount - 1))> indices{};
+    size_t n = 0;
+    for (unsigned int i = 0; i < StackCount; ++i) {
+        unsigned int k1 = i * (SectorCount + 1);    // Beginning of current stack
+        unsigned int k2 = k1 + SectorCount + 1;     // Beginning of next stack
+        for (unsigned int j = 0; j < SectorCount; ++j, ++k1, ++k2) {
+            if (i != 0) {
+                indices[n++] = k1;
+                indices[n++] = k2;
+                indices[n++] = k1 + 1;
+            }
+            if (i != (StackCount - 1)) {
+                indices[n++] = k1 + 1;
+                indices[n++] = k2;
+                indices[n++] = k2 + 1;
+            }
+        }
+    }
+    return indices;
+}
+
+// Box centered at the origin; size = Num / Den along each axis (default: unit cube)
+template <int WidthNum = 1, int HeightNum = WidthNum, int DepthNum = WidthNum, int Den = 1>
+struct Box {
+    static constexpr std::array<Vertex, 24> vertices =
+        makeBoxVertices(Vertex{ 0.0f, 0.0f, 0.0f, 0.0f, 0.0f },
+                        (float)WidthNum / Den, (float)HeightNum / Den, (float)DepthNum / Den);
+    static constexpr std::array<unsigned int, 36> indices = makeBoxIndices();
+};
+
+// Pyramid centered at the origin; base and height = Num / Den (default: 1 x 1)
+template <int BaseNum = 1, int HeightNum = 1, int Den = 1>
+struct Pyramid {
+    static constexpr std::array<Vertex, 18> vertices =
+        makePyramidVertices(Vertex{ 0.0f, 0.0f, 0.0f, 0.0f, 0.0f }, (float)BaseNum / Den, (float)HeightNum / Den);
+    static constexpr std::array<unsigned int, 18> indices = makePyramidIndices();
+};
+
+// Stack/sector sphere; radius = RadiusNum / RadiusDen (default 0.5 like Lab3_sphere).
+// Compile time grows with the vertex count, so keep this to modest tessellations.
+template <unsigned int SectorCount, unsigned int StackCount, int RadiusNum = 1, int RadiusDen = 2>
+struct Sphere {
+    static constexpr auto vertices = makeSphereVertices<SectorCount, StackCount>((float)RadiusNum / RadiusDen);
+    static constexpr auto indices = makeSphereIndices<SectorCount, StackCount>();
+};
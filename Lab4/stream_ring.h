@@ -0,0 +1,145 @@
+#pragma once
+
+// Ring buffer for data that is rewritten every frame (animated vertices,
+// instance matrices).
+//
+// One buffer object is split into frameCount segments (three by default);
+// frame N writes into segment N % frameCount. Writes go through unsynchronized
+// glMapBufferRange, so the driver never waits for the GPU or copies the
+// buffer behind our back, as glBufferData on an in-use buffer may. Instead,
+// endFrame puts a fence after the frame's draws and beginFrame waits on the
+// fence of the segment it is about to reuse, which has normally signalled
+// long ago. A wait that actually blocks is counted as a stall.
+//
+// Mapping uses the GL_COPY_WRITE_BUFFER binding, so it never disturbs the
+// array or element buffer bindings of the current VAO. Like ShaderProgram, the
+// destructor makes no GL calls; call destroy() while the context exists.
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+struct StreamRingStats {
+    size_t frames = 0;
+    size_t stalls = 0;            // beginFrame calls that had to wait for the GPU
+    double stallMs = 0.0;
+    size_t bytes = 0;             // Everything handed out, over all frames
+    size_t peakFrameBytes = 0;
+    size_t overflows = 0;         // Requests that did not fit in the frame's segment
+};
+
+class StreamRing {
+public:
+    StreamRing() = default;
+    StreamRing(const StreamRing&) = delete;
+    StreamRing& operator=(const StreamRing&) = delete;
+
+    // Room for frameBytes of data per frame, frameCount frames in flight
+    bool create(size_t frameBytes, unsigned int frameCount = 3) {
+        destroy();
+        segmentBytes = (frameBytes + 255) & ~(size_t)255;
+        fences.assign(frameCount, nullptr);
+        glGenBuffers(1, &vbo);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+        glBufferData(GL_COPY_WRITE_BUFFER, segmentBytes * frameCount, nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return glGetError() == GL_NO_ERROR;
+    }
+
+    void destroy() {
+        for (GLsync& fence : fences) {
+            if (fence)
+                glDeleteSync(fence);
+        }
+        fences.clear();
+        if (vbo)
+            glDeleteBuffers(1, &vbo);
+        vbo = 0;
+        segmentBytes = 0;
+        current = 0;
+        used = 0;
+    }
+
+    // Start writing the next segment, first waiting until the GPU is done with its previous contents
+    void beginFrame() {
+        used = 0;
+        GLsync& fence = fences[current];
+        if (!fence)
+            return;
+        if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            auto start = std::chrono::steady_clock::now();
+            while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+                ;   // One second at a time
+            std::chrono::duration<double, std::milli> waited = std::chrono::steady_clock::now() - start;
+            counters.stallMs += waited.count();
+            ++counters.stalls;
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    // Map size bytes of this frame's segment for writing; offset receives their position in
+    // buffer(). Unmap before drawing from them. nullptr if the segment is full.
+    void* map(size_t size, size_t& offset, size_t alignment = 16) {
+        size_t start = (used + alignment - 1) / alignment * alignment;
+        if (start + size > segmentBytes) {
+            ++counters.overflows;
+            return nullptr;
+        }
+        used = start + size;
+        offset = current * segmentBytes + start;
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+        return glMapBufferRange(GL_COPY_WRITE_BUFFER, (GLintptr)offset, (GLsizeiptr)size,
+                                GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    }
+
+    void unmap() {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    // Copy data into this frame's segment; false if it does not fit
+    bool write(const void* data, size_t size, size_t& offset, size_t alignment = 16) {
+        void* target = map(size, offset, alignment);
+        if (!target)
+            return false;
+        memcpy(target, data, size);
+        unmap();
+        return true;
+    }
+
+    // Fence the segment after the draws that read it, and move on to the next one
+    void endFrame() {
+        fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        current = (current + 1) % fences.size();
+        counters.bytes += used;
+        counters.peakFrameBytes = std::max(counters.peakFrameBytes, used);
+        ++counters.frames;
+    }
+
+    unsigned int buffer() const { return vbo; }
+    size_t frameCapacity() const { return segmentBytes; }
+    const StreamRingStats& stats() const { return counters; }
+
+    void printReport(const char* label) const {
+        double perFrame = counters.frames ? (double)counters.bytes / counters.frames : 0.0;
+        printf("%s: %zu x %.1f KiB segments, %zu frames, %.1f KiB streamed per frame (peak %.1f KiB), "
+               "%zu stalls (%.2f ms waiting), %zu overflows\n", label, fences.size(), segmentBytes / 1024.0,
+               counters.frames, perFrame / 1024.0, counters.peakFrameBytes / 1024.0, counters.stalls, counters.stallMs,
+               counters.overflows);
+    }
+
+private:
+    unsigned int vbo = 0;
+    size_t segmentBytes = 0;
+    std::vector<GLsync> fences;
+    size_t current = 0;
+    size_t used = 0;
+    StreamRingStats counters;
+};
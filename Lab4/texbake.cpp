@@ -0,0 +1,51 @@
+// Offline texture baker: decodes images once and writes .ctex files (see
+// baked_texture.h) that loadTexture maps and uploads without decoding.
+//
+// Build: g++ -O2 -std=c++17 texbake.cpp -o texbake
+// Usage: ./texbake [--no-flip] image.jpg ...    writes image.ctex next to each input
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "baked_texture.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+int main(int argc, char* argv[]) {
+    bool flip = true;   // Match loadTexture's default stbi_set_flip_vertically_on_load(true)
+    int baked = 0, failed = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--no-flip") == 0) {
+            flip = false;
+            continue;
+        }
+
+        int width, height, channels;
+        stbi_set_flip_vertically_on_load(flip);
+        unsigned char* pixels = stbi_load(argv[i], &width, &height, &channels, 0);
+        if (!pixels) {
+            fprintf(stderr, "%s: %s\n", argv[i], stbi_failure_reason());
+            ++failed;
+            continue;
+        }
+
+        std::string output = bakedTexturePath(argv[i]);
+        if (writeBakedTexture(output.c_str(), pixels, width, height, channels, flip ? BAKED_TEXTURE_FLIPPED : 0)) {
+            printf("%s -> %s (%dx%d, %d channels)\n", argv[i], output.c_str(), width, height, channels);
+            ++baked;
+        }
+        else {
+            fprintf(stderr, "%s: could not write %s\n", argv[i], output.c_str());
+            ++failed;
+        }
+        stbi_image_free(pixels);
+    }
+
+    if (baked + failed == 0) {
+        fprintf(stderr, "Usage: %s [--no-flip] image.jpg ...\n", argv[0]);
+        return 1;
+    }
+    return failed ? 1 : 0;
+}
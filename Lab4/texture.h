@@ -0,0 +1,540 @@
+#pragma once
+
+// Texture loading for the Lab4 demos.
+//
+// loadTexture decodes an image file with stb_image and uploads it as a
+// mipmapped GL_TEXTURE_2D. TextureCache sits in front of it: textures are
+// keyed by canonical path plus load options, so loading the same file twice
+// returns the same GL texture (reference counted) instead of decoding,
+// uploading and storing it again.
+//
+// AsyncTextureLoader moves the decoding off the GL thread: request() returns
+// a texture showing a placeholder right away, worker threads decode in
+// parallel, and the GL thread uploads finished images with uploadPending()
+// under a per-frame time budget. A TextureCache can load through it.
+//
+// Both paths first look for a baked brick.ctex next to brick.jpg (see
+// baked_texture.h and texbake.cpp). If it exists and is not older than the
+// image, it is memory-mapped and its mip levels are uploaded directly.
+// Given an AssetPack (asset_pack.h), the cache resolves names inside the
+// pack first and loads from the mapped archive instead of loose files.
+
+#include <glad/glad.h>
+#include "stb_image.h"
+#include "asset_pack.h"
+#include "baked_texture.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Load parameters; two loads share a texture only if these match
+struct TextureOptions {
+    bool flipVertically = true;     // GL expects the bottom row first
+    bool generateMipmaps = true;
+    GLint wrap = GL_REPEAT;
+};
+
+// Upload decoded pixels into texture (bound to GL_TEXTURE_2D afterwards) and
+// set its sampling state. Returns the bytes uploaded, including the mip chain.
+inline size_t uploadTextureImage(unsigned int texture, const unsigned char* pixels, int texWidth, int texHeight,
+                                 int nrChannels, const TextureOptions& options) {
+    GLenum format = GL_RGB;
+    if (nrChannels == 1)
+        format = GL_RED;
+    else if (nrChannels == 2)
+        format = GL_RG;
+    else if (nrChannels == 4)
+        format = GL_RGBA;
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);      // Rows are tightly packed whatever the channel count
+    glTexImage2D(GL_TEXTURE_2D, 0, format, texWidth, texHeight, 0, format, GL_UNSIGNED_BYTE, pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (options.generateMipmaps)
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+    // Set texture wrapping/filtering options
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, options.wrap); // S axis
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, options.wrap); // T axis
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                    options.generateMipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR); // Minification
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); // Magnification
+
+    size_t bytes = (size_t)texWidth * texHeight * nrChannels;
+    return options.generateMipmaps ? bytes * 4 / 3 : bytes;    // A full mip chain adds a third
+}
+
+// Upload a parsed .ctex; 0 (texture untouched) if it was baked with a different flip
+inline size_t uploadBakedTexture(unsigned int texture, const BakedTextureView& baked, const TextureOptions& options) {
+    if (((baked.header->flags & BAKED_TEXTURE_FLIPPED) != 0) != options.flipVertically)
+        return 0;
+
+    const GLenum formats[4] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+    GLenum format = formats[baked.header->channels - 1];
+    uint32_t levelCount = options.generateMipmaps ? baked.header->levelCount : 1;
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    size_t bytes = 0;
+    for (uint32_t level = 0; level < levelCount; ++level) {
+        glTexImage2D(GL_TEXTURE_2D, (GLint)level, format, (GLsizei)baked.levels[level].width,
+                     (GLsizei)baked.levels[level].height, 0, format, GL_UNSIGNED_BYTE, baked.levelData(level));
+        bytes += (size_t)baked.levels[level].size;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levelCount - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, options.wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, options.wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                    options.generateMipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return bytes;
+}
+
+// Upload sourcePath's baked .ctex into texture if there is a usable one: present,
+// at least as new as the source, valid, and baked with the same flip. Returns
+// the bytes uploaded, or 0 (texture untouched) so the caller decodes instead.
+inline size_t uploadBakedTexture(unsigned int texture, const char* sourcePath, const TextureOptions& options) {
+    std::string bakedPath = bakedTexturePath(sourcePath);
+    std::error_code error;
+    auto bakedTime = std::filesystem::last_write_time(bakedPath, error);
+    if (error)
+        return 0;
+    auto sourceTime = std::filesystem::last_write_time(sourcePath, error);
+    if (!error && bakedTime < sourceTime)
+        return 0;                                   // Stale: the image was edited after baking
+
+    MappedFile file(bakedPath.c_str());
+    BakedTextureView baked;
+    if (!file.isOpen() || !parseBakedTexture(file.data(), file.size(), baked))
+        return 0;
+    return uploadBakedTexture(texture, baked, options);
+}
+
+// Decode and upload an image. residentBytes (optional) receives the size of the
+// uploaded data including the mip chain. On failure an empty texture is returned.
+inline unsigned int loadTexture(const char* path, const TextureOptions& options = TextureOptions(),
+                                size_t* residentBytes = nullptr) {
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    if (residentBytes)
+        *residentBytes = 0;
+
+    // Baked textures need no decoding or mipmap generation
+    if (size_t bakedBytes = uploadBakedTexture(textureID, path, options)) {
+        if (residentBytes)
+            *residentBytes = bakedBytes;
+        return textureID;
+    }
+
+    int texWidth, texHeight, nrChannels;
+    stbi_set_flip_vertically_on_load(options.flipVertically);
+    unsigned char* data = stbi_load(path, &texWidth, &texHeight, &nrChannels, 0);
+    if (data) {
+        size_t bytes = uploadTextureImage(textureID, data, texWidth, texHeight, nrChannels, options);
+        if (residentBytes)
+            *residentBytes = bytes;
+        stbi_image_free(data);
+    }
+    else {
+        std::cerr << "Failed to load texture: " << path << std::endl;
+    }
+
+    return textureID;
+}
+
+// Upload an AssetType::Texture asset straight from the pack; 0 if it is not one or
+// does not match options (a pack holds a single baked version of each image)
+inline size_t uploadBakedTexture(unsigned int texture, const AssetView& asset, const TextureOptions& options) {
+    BakedTextureView baked;
+    if (asset.type != AssetType::Texture || !parseBakedTexture(asset.data, asset.size, baked))
+        return 0;
+    return uploadBakedTexture(texture, baked, options);
+}
+
+// loadTexture for an image inside an asset pack: baked textures are uploaded from
+// the mapping, encoded images are decoded from it. name is only used for errors.
+inline unsigned int loadTexture(const AssetView& asset, const char* name,
+                                const TextureOptions& options = TextureOptions(), size_t* residentBytes = nullptr) {
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    size_t bytes = uploadBakedTexture(textureID, asset, options);
+
+    if (asset.type == AssetType::Image) {
+        int texWidth, texHeight, nrChannels;
+        stbi_set_flip_vertically_on_load(options.flipVertically);
+        unsigned char* data = stbi_load_from_memory(asset.data, (int)asset.size, &texWidth, &texHeight, &nrChannels, 0);
+        if (data) {
+            bytes = uploadTextureImage(textureID, data, texWidth, texHeight, nrChannels, options);
+            stbi_image_free(data);
+        }
+    }
+    if (!bytes)
+        std::cerr << "Failed to load texture: " << name << " (asset pack)" << std::endl;
+
+    if (residentBytes)
+        *residentBytes = bytes;
+    return textureID;
+}
+
+// Decodes on worker threads, uploads on the GL thread. Every method except the
+// constructor and destructor must be called from the thread that owns the GL context.
+class AsyncTextureLoader {
+public:
+    explicit AsyncTextureLoader(unsigned threadCount = 0) {
+        if (threadCount == 0)
+            threadCount = std::max(1u, std::min(4u, std::thread::hardware_concurrency()));
+        for (unsigned i = 0; i < threadCount; ++i)
+            workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~AsyncTextureLoader() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        wake.notify_all();
+        for (std::thread& t : workers)
+            t.join();
+        for (Decoded& image : decoded)
+            stbi_image_free(image.pixels);
+    }
+
+    AsyncTextureLoader(const AsyncTextureLoader&) = delete;
+    AsyncTextureLoader& operator=(const AsyncTextureLoader&) = delete;
+
+    // Called after each deferred upload with the texture and its size in bytes
+    std::function<void(unsigned int texture, size_t bytes)> onUploaded;
+
+    // Return a texture that shows a 1x1 placeholder until the image is decoded and uploaded.
+    // residentBytes (optional) is nonzero if it could be uploaded right away (baked).
+    unsigned int request(const char* path, const TextureOptions& options = TextureOptions(),
+                         size_t* residentBytes = nullptr) {
+        TextureBindingGuard guard;
+        unsigned int texture;
+        glGenTextures(1, &texture);
+
+        // A baked texture uploads straight from the mapped file, faster than a round trip to a worker
+        size_t bakedBytes = uploadBakedTexture(texture, path, options);
+        if (residentBytes)
+            *residentBytes = bakedBytes;
+        if (bakedBytes)
+            return texture;
+
+        queueDecode({ 0, texture, path, AssetView(), options });
+        return texture;
+    }
+
+    // Same for an image inside an asset pack, which must stay open until it has been uploaded
+    unsigned int request(const AssetView& asset, const char* name, const TextureOptions& options = TextureOptions(),
+                         size_t* residentBytes = nullptr) {
+        TextureBindingGuard guard;
+        unsigned int texture;
+        glGenTextures(1, &texture);
+
+        size_t bakedBytes = uploadBakedTexture(texture, asset, options);
+        if (residentBytes)
+            *residentBytes = bakedBytes;
+        if (bakedBytes)
+            return texture;
+        if (asset.type != AssetType::Image) {
+            std::cerr << "Failed to load texture: " << name << " (asset pack)" << std::endl;
+            return texture;
+        }
+
+        queueDecode({ 0, texture, name, asset, options });
+        return texture;
+    }
+
+    // Upload decoded images until budgetMs has been spent; at least one is
+    // uploaded per call if any is ready. Returns the number uploaded.
+    size_t uploadPending(double budgetMs) {
+        auto start = std::chrono::steady_clock::now();
+        TextureBindingGuard guard;
+        size_t uploaded = 0;
+        for (;;) {
+            Decoded image;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (decoded.empty())
+                    break;
+                image = decoded.front();
+                decoded.pop_front();
+            }
+
+            // A cancelled request may share its texture name with a newer one: go by request id
+            bool live = pendingRequests.erase(image.request) > 0;
+            cancelled.erase(image.request);
+            if (live && image.pixels) {
+                size_t bytes = uploadTextureImage(image.texture, image.pixels, image.width, image.height,
+                                                  image.channels, image.options);
+                if (onUploaded)
+                    onUploaded(image.texture, bytes);
+                ++uploaded;
+            }
+            stbi_image_free(image.pixels);
+
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            if (elapsed.count() >= budgetMs)
+                break;
+        }
+        return uploaded;
+    }
+
+    // Block until every requested texture has been uploaded
+    void finish() {
+        while (!pendingRequests.empty()) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [this] { return !decoded.empty(); });
+            }
+            uploadPending(1e9);
+        }
+    }
+
+    // The texture is about to be deleted: drop its image when it arrives
+    void cancel(unsigned int texture) {
+        for (auto request = pendingRequests.begin(); request != pendingRequests.end();) {
+            if (request->second == texture) {
+                cancelled.insert(request->first);
+                request = pendingRequests.erase(request);
+            }
+            else {
+                ++request;
+            }
+        }
+    }
+
+    // Requested textures still showing the placeholder
+    size_t pending() const { return pendingRequests.size(); }
+
+private:
+    // Uploads happen mid-frame: put back whatever the caller had bound
+    struct TextureBindingGuard {
+        GLint previous = 0;
+        TextureBindingGuard() { glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous); }
+        ~TextureBindingGuard() { glBindTexture(GL_TEXTURE_2D, (GLuint)previous); }
+    };
+
+    struct Request {
+        size_t id;                  // Unique per request; GL reuses the names of deleted textures
+        unsigned int texture;
+        std::string path;
+        AssetView encoded;          // Decoded from memory instead of path when set
+        TextureOptions options;
+    };
+
+    struct Decoded {
+        size_t request = 0;
+        unsigned int texture = 0;
+        unsigned char* pixels = nullptr;    // Null if decoding failed
+        int width = 0, height = 0, channels = 0;
+        TextureOptions options;
+    };
+
+    // Show a 1x1 placeholder in the request's texture and hand it to a worker
+    void queueDecode(Request request) {
+        const unsigned char placeholder[4] = { 128, 128, 128, 255 };
+        glBindTexture(GL_TEXTURE_2D, request.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);    // No mips: complete as is
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        request.id = nextRequestId++;
+        pendingRequests.emplace(request.id, request.texture);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            requests.push_back(request);
+        }
+        wake.notify_one();
+    }
+
+    void workerLoop() {
+        for (;;) {
+            Request request;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return quit || !requests.empty(); });
+                if (quit)
+                    return;
+                request = requests.front();
+                requests.pop_front();
+            }
+
+            // The global flip flag belongs to the GL thread's loadTexture; use the per-thread one
+            Decoded image;
+            image.request = request.id;
+            image.texture = request.texture;
+            image.options = request.options;
+            stbi_set_flip_vertically_on_load_thread(request.options.flipVertically);
+            if (request.encoded)
+                image.pixels = stbi_load_from_memory(request.encoded.data, (int)request.encoded.size, &image.width,
+                                                     &image.height, &image.channels, 0);
+            else
+                image.pixels = stbi_load(request.path.c_str(), &image.width, &image.height, &image.channels, 0);
+            if (!image.pixels)
+                std::cerr << "Failed to load texture: " << request.path << std::endl;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                decoded.push_back(image);
+            }
+            ready.notify_one();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake, ready;
+    std::deque<Request> requests;       // Waiting for a worker
+    std::deque<Decoded> decoded;        // Waiting for the GL thread
+    bool quit = false;
+
+    // GL thread only
+    size_t nextRequestId = 0;
+    std::unordered_map<size_t, unsigned int> pendingRequests;   // Request id -> texture, until uploaded or cancelled
+    std::unordered_set<size_t> cancelled;                       // Request ids whose image is dropped on arrival
+};
+
+// Hit/miss counters and GPU memory held by a TextureCache
+struct TextureCacheStats {
+    size_t hits = 0, misses = 0;
+    size_t residentBytes = 0;       // Texture data currently uploaded
+    size_t savedBytes = 0;          // Uploads avoided by hits
+};
+
+// Reference-counted, path-keyed front end for loadTexture. Not thread safe;
+// use it from the thread that owns the GL context. Release every texture
+// before the context goes away (the destructor makes no GL calls).
+// With a loader, misses are loaded asynchronously and their sizes are
+// counted once uploaded. A pack must stay open while textures from it load.
+class TextureCache {
+public:
+    explicit TextureCache(AsyncTextureLoader* loader = nullptr, const AssetPack* pack = nullptr)
+        : loader(loader), pack(pack) {
+        if (loader)
+            loader->onUploaded = [this](unsigned int texture, size_t bytes) { uploaded(texture, bytes); };
+    }
+
+    ~TextureCache() {
+        if (loader)
+            loader->onUploaded = nullptr;
+    }
+
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    // Return the texture for path/options, loading it on first use. With a pack,
+    // path is looked up there first and the file system is only the fallback.
+    unsigned int acquire(const char* path, const TextureOptions& options = TextureOptions()) {
+        AssetView asset = pack ? pack->find(path) : AssetView();
+        std::string key = makeKey(path, options, asset);
+        auto found = entries.find(key);
+        if (found != entries.end()) {
+            ++found->second.refCount;
+            ++found->second.hits;
+            ++counters.hits;
+            counters.savedBytes += found->second.bytes;
+            return found->second.texture;
+        }
+
+        Entry entry;
+        if (asset)
+            entry.texture = loader ? loader->request(asset, path, options, &entry.bytes)
+                                   : loadTexture(asset, path, options, &entry.bytes);
+        else
+            entry.texture = loader ? loader->request(path, options, &entry.bytes)
+                                   : loadTexture(path, options, &entry.bytes);
+        entry.refCount = 1;
+        ++counters.misses;
+        counters.residentBytes += entry.bytes;
+        entries.emplace(key, entry);
+        keys.emplace(entry.texture, key);
+        return entry.texture;
+    }
+
+    // Drop one reference; the GL texture is deleted with the last one
+    void release(unsigned int texture) {
+        auto key = keys.find(texture);
+        if (key == keys.end())
+            return;
+        auto entry = entries.find(key->second);
+        if (--entry->second.refCount > 0)
+            return;
+
+        if (loader)
+            loader->cancel(texture);
+        glDeleteTextures(1, &texture);
+        counters.residentBytes -= entry->second.bytes;
+        entries.erase(entry);
+        keys.erase(key);
+    }
+
+    size_t size() const { return entries.size(); }
+    const TextureCacheStats& stats() const { return counters; }
+
+    void printReport(const char* label) const {
+        printf("%s: %zu hits, %zu misses, %zu textures resident (%.1f KiB), %.1f KiB of uploads avoided\n",
+               label, counters.hits, counters.misses, entries.size(), counters.residentBytes / 1024.0,
+               counters.savedBytes / 1024.0);
+    }
+
+private:
+    struct Entry {
+        unsigned int texture = 0;
+        int refCount = 0;
+        size_t hits = 0;
+        size_t bytes = 0;           // 0 until an asynchronous load is uploaded
+    };
+
+    void uploaded(unsigned int texture, size_t bytes) {
+        auto key = keys.find(texture);
+        if (key == keys.end())
+            return;
+        Entry& entry = entries[key->second];
+        entry.bytes = bytes;
+        counters.residentBytes += bytes;
+        counters.savedBytes += bytes * entry.hits;     // Hits while it was still loading
+    }
+
+    // "brick.jpg", "./brick.jpg" and an absolute path to it all give the same key.
+    // Pack assets are keyed by their name, which is already unique within the pack.
+    static std::string makeKey(const char* path, const TextureOptions& options, const AssetView& asset) {
+        std::string key;
+        if (asset) {
+            key = "pack:";
+            key += path;
+        }
+        else {
+            std::error_code error;
+            std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+            key = error ? std::string(path) : canonical.string();
+        }
+        key += '|';
+        key += options.flipVertically ? 'f' : '-';
+        key += options.generateMipmaps ? 'm' : '-';
+        key += std::to_string(options.wrap);
+        return key;
+    }
+
+    std::unordered_map<std::string, Entry> entries;
+    std::unordered_map<unsigned int, std::string> keys;     // Texture -> its entry
+    TextureCacheStats counters;
+    AsyncTextureLoader* loader;
+    const AssetPack* pack;
+};
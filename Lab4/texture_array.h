@@ -0,0 +1,174 @@
+#pragma once
+
+// GL_TEXTURE_2D_ARRAY loading: several images resized to one size and stored
+// as the layers of a single array texture. A mesh whose faces use different
+// images can then be drawn in one call, with the layer chosen per vertex
+// (uploadVertexLayers in gl_mesh.h) instead of by rebinding or switching
+// sampler uniforms between draws.
+
+#include <glad/glad.h>
+#include "stb_image.h"
+#include "asset_pack.h"
+#include "baked_texture.h"
+#include "texture.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Resample src to dstWidth x dstHeight. Downscaling halves with a box filter
+// until within 2x of the target, then finishes bilinearly (pixel centers aligned).
+inline std::vector<unsigned char> resizeImage(const unsigned char* src, int width, int height, int channels,
+                                              int dstWidth, int dstHeight) {
+    std::vector<unsigned char> halved(src, src + (size_t)width * height * channels);
+    while (width >= 2 * dstWidth && height >= 2 * dstHeight)
+        halved = downsampleLevel(halved.data(), width, height, channels, width, height);
+    if (width == dstWidth && height == dstHeight)
+        return halved;
+
+    std::vector<unsigned char> dst((size_t)dstWidth * dstHeight * channels);
+    float scaleX = (float)width / dstWidth, scaleY = (float)height / dstHeight;
+    for (int y = 0; y < dstHeight; ++y) {
+        float sy = std::max(0.0f, (y + 0.5f) * scaleY - 0.5f);
+        int y0 = std::min((int)sy, height - 1), y1 = std::min(y0 + 1, height - 1);
+        float fy = sy - y0;
+        for (int x = 0; x < dstWidth; ++x) {
+            float sx = std::max(0.0f, (x + 0.5f) * scaleX - 0.5f);
+            int x0 = std::min((int)sx, width - 1), x1 = std::min(x0 + 1, width - 1);
+            float fx = sx - x0;
+            for (int c = 0; c < channels; ++c) {
+                const unsigned char* row0 = &halved[(size_t)y0 * width * channels];
+                const unsigned char* row1 = &halved[(size_t)y1 * width * channels];
+                float top = row0[x0 * channels + c] + (row0[x1 * channels + c] - row0[x0 * channels + c]) * fx;
+                float bottom = row1[x0 * channels + c] + (row1[x1 * channels + c] - row1[x0 * channels + c]) * fx;
+                dst[((size_t)y * dstWidth + x) * channels + c] = (unsigned char)(top + (bottom - top) * fy + 0.5f);
+            }
+        }
+    }
+    return dst;
+}
+
+// Expand pixels to more channels (stb_image layouts: grey, grey+alpha, RGB, RGBA).
+// Grey is replicated to RGB and a missing alpha is opaque.
+inline std::vector<unsigned char> expandChannels(const unsigned char* src, size_t pixelCount, int channels,
+                                                 int dstChannels) {
+    std::vector<unsigned char> dst(pixelCount * dstChannels);
+    bool colour = channels >= 3;
+    for (size_t i = 0; i < pixelCount; ++i) {
+        const unsigned char* p = src + i * channels;
+        unsigned char* q = &dst[i * dstChannels];
+        unsigned char alpha = channels == 2 ? p[1] : channels == 4 ? p[3] : 255;
+        if (dstChannels <= 2) {
+            q[0] = p[0];
+            if (dstChannels == 2)
+                q[1] = alpha;
+        }
+        else {
+            q[0] = p[0];
+            q[1] = colour ? p[1] : p[0];
+            q[2] = colour ? p[2] : p[0];
+            if (dstChannels == 4)
+                q[3] = alpha;
+        }
+    }
+    return dst;
+}
+
+// Build a texture array with one layer per path, all resized to layerWidth x layerHeight
+// (0 picks the largest source size). Paths are looked up in pack first when given.
+// The images are decoded in parallel; layers that fail to load stay black.
+inline unsigned int loadTextureArray(const std::vector<std::string>& paths, int layerWidth = 0, int layerHeight = 0,
+                                     const TextureOptions& options = TextureOptions(), const AssetPack* pack = nullptr,
+                                     size_t* residentBytes = nullptr) {
+    struct Layer {
+        std::vector<unsigned char> pixels;
+        int width = 0, height = 0, channels = 0;
+    };
+    std::vector<Layer> layers(paths.size());
+
+    defaultThreadPool().run(paths.size(), [&](size_t i, unsigned) {
+        Layer& layer = layers[i];
+        AssetView asset = pack ? pack->find(paths[i]) : AssetView();
+        BakedTextureView baked;
+        if (asset.type == AssetType::Texture && parseBakedTexture(asset.data, asset.size, baked) &&
+            ((baked.header->flags & BAKED_TEXTURE_FLIPPED) != 0) == options.flipVertically) {
+            // Level 0 of a baked texture is already decoded
+            layer.width = (int)baked.levels[0].width;
+            layer.height = (int)baked.levels[0].height;
+            layer.channels = (int)baked.header->channels;
+            layer.pixels.assign(baked.levelData(0), baked.levelData(0) + baked.levels[0].size);
+            return;
+        }
+
+        stbi_set_flip_vertically_on_load_thread(options.flipVertically);
+        unsigned char* data = asset.type == AssetType::Image
+            ? stbi_load_from_memory(asset.data, (int)asset.size, &layer.width, &layer.height, &layer.channels, 0)
+            : stbi_load(paths[i].c_str(), &layer.width, &layer.height, &layer.channels, 0);
+        if (!data) {
+            layer.width = layer.height = layer.channels = 0;
+            return;
+        }
+        layer.pixels.assign(data, data + (size_t)layer.width * layer.height * layer.channels);
+        stbi_image_free(data);
+    });
+
+    int channels = 1;
+    for (size_t i = 0; i < layers.size(); ++i) {
+        if (layers[i].pixels.empty())
+            std::cerr << "Failed to load texture array layer: " << paths[i] << std::endl;
+        if (layerWidth == 0 || layerHeight == 0) {
+            // Largest source size, so no layer is downscaled
+            layerWidth = std::max(layerWidth, layers[i].width);
+            layerHeight = std::max(layerHeight, layers[i].height);
+        }
+        channels = std::max(channels, layers[i].channels);
+    }
+    layerWidth = std::max(layerWidth, 1);
+    layerHeight = std::max(layerHeight, 1);
+
+    // Bring every layer to the common size and channel count, in parallel as well
+    defaultThreadPool().run(layers.size(), [&](size_t i, unsigned) {
+        Layer& layer = layers[i];
+        if (layer.pixels.empty()) {
+            layer.pixels.assign((size_t)layerWidth * layerHeight * channels, 0);
+        }
+        else {
+            if (layer.channels != channels)
+                layer.pixels = expandChannels(layer.pixels.data(), (size_t)layer.width * layer.height,
+                                              layer.channels, channels);
+            if (layer.width != layerWidth || layer.height != layerHeight)
+                layer.pixels = resizeImage(layer.pixels.data(), layer.width, layer.height, channels, layerWidth,
+                                           layerHeight);
+        }
+    });
+
+    const GLenum formats[4] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+    GLenum format = formats[channels - 1];
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, format, layerWidth, layerHeight, (GLsizei)layers.size(), 0, format,
+                 GL_UNSIGNED_BYTE, nullptr);
+    for (size_t i = 0; i < layers.size(); ++i) {
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, (GLint)i, layerWidth, layerHeight, 1, format, GL_UNSIGNED_BYTE,
+                        layers[i].pixels.data());
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (options.generateMipmaps)
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, options.wrap);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, options.wrap);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+                    options.generateMipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    if (residentBytes) {
+        size_t bytes = (size_t)layerWidth * layerHeight * channels * layers.size();
+        *residentBytes = options.generateMipmaps ? bytes * 4 / 3 : bytes;
+    }
+    return texture;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker pool; run() spreads jobs over the workers and the calling thread
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threadCount = 0) {
+        if (threadCount == 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned i = 1; i < threadCount; ++i)
+            workers.emplace_back([this, i] { workerLoop(i); });
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        wake.notify_all();
+        for (std::thread& t : workers)
+            t.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return (unsigned)workers.size() + 1; }
+
+    // Call fn(job, worker) for every job in [0, jobCount) and wait for all of them.
+    // Concurrent callers are serialized; fn must not call run() on the same pool.
+    void run(size_t jobCount, const std::function<void(size_t, unsigned)>& fn) {
+        if (jobCount == 0)
+            return;
+        if (workers.empty() || jobCount == 1) {
+            for (size_t j = 0; j < jobCount; ++j)
+                fn(j, 0);
+            return;
+        }
+
+        std::lock_guard<std::mutex> runLock(runMutex);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            task = &fn;
+            taskJobs = jobCount;
+            nextJob = 0;
+            busyWorkers = (unsigned)workers.size();
+            ++generation;
+        }
+        wake.notify_all();
+
+        drainJobs(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return busyWorkers == 0; });
+        task = nullptr;
+    }
+
+private:
+    void drainJobs(unsigned worker) {
+        for (size_t j = nextJob.fetch_add(1); j < taskJobs; j = nextJob.fetch_add(1))
+            (*task)(j, worker);
+    }
+
+    void workerLoop(unsigned worker) {
+        uint64_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return quit || generation != seen; });
+                if (quit)
+                    return;
+                seen = generation;
+            }
+            drainJobs(worker);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--busyWorkers == 0)
+                    done.notify_one();
+            }
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex runMutex;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    const std::function<void(size_t, unsigned)>* task = nullptr;
+    size_t taskJobs = 0;
+    std::atomic<size_t> nextJob{0};
+    unsigned busyWorkers = 0;
+    uint64_t generation = 0;
+    bool quit = false;
+};
+
+// Process-wide pool sized to the machine, for helpers that do not own one
+inline ThreadPool& defaultThreadPool() {
+    static ThreadPool pool;
+    return pool;
+}
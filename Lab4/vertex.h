@@ -0,0 +1,7 @@
+#pragma once
+
+// Vertex structure with texture coordinates (shared by the Lab4 demos and helpers)
+struct Vertex {
+    float x, y, z;   // Position
+    float u, v;      // Texture coordinates
+};